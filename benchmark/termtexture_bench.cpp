@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cellgrid.h>
+#include <chrono>
+#include <fontatlas.h>
+#include <functional>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <unicode.h>
+#include <vector>
+#include <vterm_object.h>
+
+// termtexture_bench [filter]
+// one json object per line:
+// {"name": ..., "runs": ..., "median_ns": ..., "min_ns": ..., "bytes": ...,
+//  "mb_per_sec": ...}
+// set TERMTEXTURE_BENCH_FONT to a ttf to run the font packing cases.
+
+class Timer {
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::nanoseconds elapsed_ = {};
+
+public:
+  void Start() { start_ = std::chrono::steady_clock::now(); }
+  void Stop() { elapsed_ += std::chrono::steady_clock::now() - start_; }
+  std::chrono::nanoseconds Elapsed() const { return elapsed_; }
+};
+
+static std::string_view g_filter;
+
+// func starts and stops the timer around the measured part.
+// bytes is the amount processed per run, 0 for none
+static void Bench(std::string_view name, size_t bytes,
+                  const std::function<void(Timer &)> &func) {
+  if (name.find(g_filter) == std::string_view::npos) {
+    return;
+  }
+  {
+    // warm up
+    Timer timer;
+    func(timer);
+  }
+  std::vector<int64_t> runs;
+  std::chrono::nanoseconds total = {};
+  while (runs.size() < 5 ||
+         (total < std::chrono::milliseconds(300) && runs.size() < 1000)) {
+    Timer timer;
+    func(timer);
+    runs.push_back(timer.Elapsed().count());
+    total += timer.Elapsed();
+  }
+  std::sort(runs.begin(), runs.end());
+  auto median = runs[runs.size() / 2];
+  printf("{\"name\": \"%.*s\", \"runs\": %zu, \"median_ns\": %lld, "
+         "\"min_ns\": %lld, \"bytes\": %zu, \"mb_per_sec\": %.3f}\n",
+         static_cast<int>(name.size()), name.data(), runs.size(),
+         static_cast<long long>(median), static_cast<long long>(runs[0]),
+         bytes, median > 0 ? bytes * 1e3 / median : 0.0);
+  fflush(stdout);
+}
+
+const int ROWS = 60;
+const int COLS = 200;
+const size_t STREAM_SIZE = 1024 * 1024;
+
+static std::string PlainStream() {
+  std::string s;
+  std::mt19937 rng(1);
+  while (s.size() < STREAM_SIZE) {
+    for (int col = 0; col < COLS - 1; ++col) {
+      s.push_back(static_cast<char>(' ' + rng() % 95));
+    }
+    s += "\r\n";
+  }
+  return s;
+}
+
+static std::string SgrStream() {
+  std::string s;
+  std::mt19937 rng(2);
+  char buf[64];
+  while (s.size() < STREAM_SIZE) {
+    snprintf(buf, sizeof(buf), "\x1b[%d;38;5;%d;48;5;%dm",
+             static_cast<int>(1 + rng() % 4),
+             static_cast<int>(rng() % 256), static_cast<int>(rng() % 256));
+    s += buf;
+    for (int i = 0, n = 1 + rng() % 8; i < n; ++i) {
+      s.push_back(static_cast<char>('a' + rng() % 26));
+    }
+    s += "\x1b[0m ";
+    if (rng() % 16 == 0) {
+      s += "\r\n";
+    }
+  }
+  return s;
+}
+
+static std::string CursorStream() {
+  std::string s;
+  std::mt19937 rng(3);
+  char buf[32];
+  while (s.size() < STREAM_SIZE) {
+    snprintf(buf, sizeof(buf), "\x1b[%d;%dH%c", static_cast<int>(1 + rng() % ROWS),
+             static_cast<int>(1 + rng() % COLS),
+             static_cast<char>('!' + rng() % 94));
+    s += buf;
+  }
+  return s;
+}
+
+static void Discard(const char *s, size_t len, void *user) {}
+
+static void BenchInputWrite(std::string_view name, const std::string &stream) {
+  Bench(name, stream.size(), [&stream](Timer &timer) {
+    VTermObject vterm(ROWS, COLS, &Discard, nullptr);
+    timer.Start();
+    vterm.input_write(stream.data(), stream.size());
+    timer.Stop();
+  });
+}
+
+static std::vector<VTermScreenCell> MakeCells(size_t count) {
+  std::vector<VTermScreenCell> cells(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto &cell = cells[i];
+    cell = {};
+    cell.chars[0] = static_cast<uint32_t>('!' + i % 94);
+    cell.width = 1;
+    cell.fg.type = VTERM_COLOR_RGB;
+    cell.fg.rgb.red = 200;
+    cell.fg.rgb.green = 200;
+    cell.fg.rgb.blue = 200;
+    cell.bg.type = VTERM_COLOR_RGB;
+    cell.bg.rgb.red = 0;
+    cell.bg.rgb.green = static_cast<uint8_t>(i);
+    cell.bg.rgb.blue = 0;
+  }
+  return cells;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    g_filter = argv[1];
+  }
+  auto font = getenv("TERMTEXTURE_BENCH_FONT");
+
+  //
+  // VTermObject::input_write
+  //
+  auto plain = PlainStream();
+  auto sgr = SgrStream();
+  auto cursor = CursorStream();
+  BenchInputWrite("vterm_input/plain", plain);
+  BenchInputWrite("vterm_input/sgr", sgr);
+  BenchInputWrite("vterm_input/cursor", cursor);
+
+  //
+  // damage collection
+  //
+  Bench("new_frame/full_screen", 0, [](Timer &timer) {
+    VTermObject vterm(ROWS, COLS, &Discard, nullptr);
+    std::string screen(ROWS * COLS, 'x');
+    vterm.input_write(screen.data(), screen.size());
+    bool ringing;
+    timer.Start();
+    vterm.new_frame(&ringing, true);
+    timer.Stop();
+  });
+  Bench("new_frame/one_line", 0, [](Timer &timer) {
+    VTermObject vterm(ROWS, COLS, &Discard, nullptr);
+    bool ringing;
+    vterm.new_frame(&ringing, true);
+    std::string line(COLS, 'x');
+    vterm.input_write(line.data(), line.size());
+    timer.Start();
+    vterm.new_frame(&ringing, true);
+    timer.Stop();
+  });
+
+  //
+  // CellGrid::SetCell / Commit. NullBackend measures only the bookkeeping
+  //
+  auto cells = MakeCells(ROWS * COLS);
+  auto grid = CellGrid::Create();
+  grid->Resize(ROWS, COLS);
+  Bench("cellgrid/full_update", 0, [&](Timer &timer) {
+    timer.Start();
+    for (int row = 0; row < ROWS; ++row) {
+      for (int col = 0; col < COLS; ++col) {
+        grid->SetCell({static_cast<uint16_t>(row), static_cast<uint16_t>(col)},
+                      cells[row * COLS + col]);
+      }
+    }
+    grid->Commit();
+    timer.Stop();
+  });
+  Bench("cellgrid/sparse_update", 0, [&](Timer &timer) {
+    std::mt19937 rng(4);
+    timer.Start();
+    // 1% of cells
+    for (int i = 0; i < ROWS * COLS / 100; ++i) {
+      auto row = rng() % ROWS;
+      auto col = rng() % COLS;
+      grid->SetCell({static_cast<uint16_t>(row), static_cast<uint16_t>(col)},
+                    cells[row * COLS + col]);
+    }
+    grid->Commit();
+    timer.Stop();
+  });
+
+  //
+  // FontAtlas
+  //
+  FontAtlas atlas;
+  if (!font || !atlas.Load(font, {8, 16}, 1024)) {
+    // lookup only
+    for (uint32_t c = 0x20; c < 0x7F; ++c) {
+      atlas.codepoint_map.insert({c, c - 0x20});
+    }
+  }
+  Bench("fontatlas/lookup", 0, [&atlas](Timer &timer) {
+    size_t sum = 0;
+    timer.Start();
+    for (uint32_t i = 0; i < 100000; ++i) {
+      uint32_t codepoint = 0x20 + i % 0x60;
+      sum += atlas.GlyphIndexFromCodePoint({&codepoint, 1});
+    }
+    timer.Stop();
+    if (sum == 1) {
+      puts("");
+    }
+  });
+  if (font) {
+    Bench("fontatlas/pack", 0, [font](Timer &timer) {
+      FontAtlas atlas;
+      timer.Start();
+      atlas.Load(font, {8, 16}, 1024);
+      timer.Stop();
+    });
+  }
+
+  //
+  // unicode tables
+  //
+  std::u32string text;
+  {
+    // ascii, cjk, combining marks and emoji sequences
+    const char32_t pool[] = {U'a', U'x', U' ', 0x4E00, 0xAC00, 0x0301,
+                             0x1F600, 0x200D, 0x1F468, 0xFE0F, 0x1F1EF};
+    std::mt19937 rng(5);
+    for (int i = 0; i < 100000; ++i) {
+      text.push_back(pool[rng() % std::size(pool)]);
+    }
+  }
+  Bench("unicode/width", text.size() * 4, [&text](Timer &timer) {
+    int sum = 0;
+    timer.Start();
+    for (auto c : text) {
+      sum += CodepointWidth(c);
+    }
+    timer.Stop();
+    if (sum == 1) {
+      puts("");
+    }
+  });
+  Bench("unicode/grapheme", text.size() * 4, [&text](Timer &timer) {
+    size_t clusters = 0;
+    timer.Start();
+    for (size_t pos = 0; pos < text.size();
+         pos = NextGraphemeBoundary(text, pos)) {
+      ++clusters;
+    }
+    timer.Stop();
+    if (clusters == 1) {
+      puts("");
+    }
+  });
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "glfw_window.h"
+#include <gl_backend.h>
+#include <gl_batch.h>
+#include <glo.h>
+#include <glo/state_cache.h>
+#include <plog/Appenders/ColorConsoleAppender.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Init.h>
+#include <plog/Log.h>
+#include <pty_sessions.h>
+#include <stdlib.h>
+#include <termtexture.h>
+#include <vector>
+
+// batch_grid font.ttf [cols rows]
+// a grid of terminals drawn by one GlBatch::Draw
+int main(int argc, char **argv) {
+  std::string fontfile = "C:/Windows/Fonts/consola.ttf";
+  if (argc > 1) {
+    fontfile = argv[1];
+  }
+  int grid_cols = argc > 2 ? atoi(argv[2]) : 4;
+  int grid_rows = argc > 3 ? atoi(argv[3]) : 4;
+  static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+  plog::init(plog::verbose, &consoleAppender);
+
+  Window window;
+  auto window_handle = window.CreaeWindow(1280, 720, "batch_grid");
+  if (!window_handle) {
+    return 1;
+  }
+  glo::InitiazlieGlew();
+
+  auto context = GlRenderContext::Create();
+  if (!context) {
+    return 2;
+  }
+  auto batch = GlBatch::Create(context);
+  if (!batch) {
+    return 2;
+  }
+
+  // one epoll loop for all ptys. nullptr on Windows, a thread per pty
+  auto sessions = PtySessions::Create();
+  if (sessions) {
+    sessions->SetWake(&Window::Wake);
+  }
+
+  auto [width, height] = window.FrameBufferSize();
+  auto tile_width = width / grid_cols;
+  auto tile_height = height / grid_rows;
+  std::vector<std::shared_ptr<termtexture::TermTexture>> terms;
+  for (int i = 0; i < grid_cols * grid_rows; ++i) {
+    auto term = termtexture::TermTexture::Create();
+    if (!term->LoadBatchFont(fontfile, {8, 16}, batch)) {
+      PLOG_ERROR << "LoadBatchFont: " << fontfile;
+      return 3;
+    }
+    term->SetWake(&Window::Wake);
+    auto size = term->TermSizeFromTextureSize(tile_width, tile_height);
+    auto launched = sessions ? term->Launch(sessions, "sh", size)
+                             : term->Launch("cmd.exe", size);
+    if (!launched) {
+      PLOG_ERROR << "Launch";
+      return 4;
+    }
+    terms.push_back(term);
+  }
+
+  // sleep until a pty has output
+  float clear_color[] = {0, 0, 0, 0};
+  std::vector<void *> ready;
+  while (window.WaitEvents()) {
+    bool dirty = window.IsDamaged();
+    if (sessions) {
+      // only the sessions that have output
+      sessions->TakeReady(ready);
+      for (auto user : ready) {
+        dirty |= static_cast<termtexture::TermTexture *>(user)->Poll();
+      }
+    } else {
+      for (auto &term : terms) {
+        dirty |= term->Poll();
+      }
+    }
+    if (!dirty) {
+      continue;
+    }
+    auto time = window.Clear(clear_color);
+    auto [width, height] = window.FrameBufferSize();
+    auto tile_width = width / grid_cols;
+    auto tile_height = height / grid_rows;
+    for (int i = 0; i < terms.size(); ++i) {
+      terms[i]->RenderBatched((i % grid_cols) * tile_width,
+                              (i / grid_cols) * tile_height, tile_width,
+                              tile_height, time);
+    }
+    batch->Draw({
+        .width = static_cast<uint16_t>(width),
+        .height = static_cast<uint16_t>(height),
+    });
+    window.EndFrame();
+    glo::StateCache::Current().EndFrame();
+  }
+
+  auto &gl_state = glo::StateCache::Current();
+  if (gl_state.Frames()) {
+    auto &total = gl_state.Total();
+    PLOG_INFO << "gl state: " << total.issued / gl_state.Frames()
+              << " calls, " << total.elided / gl_state.Frames()
+              << " elided per frame";
+  }
+
+  return 0;
+}
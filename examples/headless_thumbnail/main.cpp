@@ -0,0 +1,64 @@
+#include "headless_context.h"
+#include <fstream>
+#include <glo.h>
+#include <iterator>
+#include <plog/Appenders/ColorConsoleAppender.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Init.h>
+#include <plog/Log.h>
+#include <string>
+#include <termtexture.h>
+#include <vector>
+
+// render a terminal output log into a ppm without a window.
+// headless_thumbnail font.ttf input.log output.ppm [width height]
+int main(int argc, char **argv) {
+  static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+  plog::init(plog::info, &consoleAppender);
+  if (argc < 4) {
+    PLOG_ERROR << "usage: " << argv[0]
+               << " font.ttf input.log output.ppm [width height]";
+    return 1;
+  }
+  int width = argc > 5 ? std::stoi(argv[4]) : 1280;
+  int height = argc > 5 ? std::stoi(argv[5]) : 720;
+
+  HeadlessContext context;
+  if (!context.Create()) {
+    return 2;
+  }
+  glo::InitiazlieGlew();
+
+  auto term = termtexture::TermTexture::Create();
+  if (!term->LoadFont(argv[1], {15, 30})) {
+    PLOG_ERROR << "LoadFont: " << argv[1];
+    return 3;
+  }
+  // no pty
+  term->Resize(width, height);
+
+  std::ifstream ifs(argv[2], std::ios::binary);
+  std::vector<char> input((std::istreambuf_iterator<char>(ifs)),
+                          std::istreambuf_iterator<char>());
+  term->InputWrite(input.data(), input.size());
+
+  term->RenderOffscreen(width, height, {});
+  std::vector<uint8_t> rgba;
+  int w, h;
+  if (!term->ReadPixels(rgba, &w, &h, true)) {
+    PLOG_ERROR << "ReadPixels";
+    return 4;
+  }
+
+  std::ofstream ofs(argv[3], std::ios::binary);
+  ofs << "P6\n" << w << " " << h << "\n255\n";
+  // bottom to top
+  for (int y = h - 1; y >= 0; --y) {
+    auto row = rgba.data() + y * w * 4;
+    for (int x = 0; x < w; ++x) {
+      ofs.write(reinterpret_cast<const char *>(row + x * 4), 3);
+    }
+  }
+  PLOG_INFO << argv[3] << ": " << w << "x" << h;
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <chrono>
+#include <plog/Appenders/ColorConsoleAppender.h>
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Init.h>
+#include <plog/Log.h>
+#include <pty_record.h>
+#include <stdio.h>
+#include <string>
+#include <termtexture.h>
+#include <vector>
+
+// replay a pty recording on the cpu backend and print frame timings as json.
+// pty_replay font.ttf capture.ttrec [--realtime]
+int main(int argc, char **argv) {
+  static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+  plog::init(plog::warning, &consoleAppender);
+  if (argc < 3) {
+    PLOG_ERROR << "usage: " << argv[0] << " font.ttf capture.ttrec [--realtime]";
+    return 1;
+  }
+  bool realtime = argc > 3 && std::string(argv[3]) == "--realtime";
+
+  auto recording = PtyRecording::Open(argv[2]);
+  if (!recording) {
+    return 2;
+  }
+  size_t total_bytes = 0;
+  {
+    PtyEvent event;
+    while (recording->Next(&event)) {
+      total_bytes += event.bytes.size();
+    }
+  }
+
+  auto term = termtexture::TermTexture::Create();
+  uint16_t cell_width = 8;
+  uint16_t cell_height = 16;
+  if (!term->LoadCpuFont(argv[1], {cell_width, cell_height})) {
+    PLOG_ERROR << "LoadCpuFont: " << argv[1];
+    return 3;
+  }
+  if (!term->StartReplay(argv[2], realtime)) {
+    return 4;
+  }
+  auto width = recording->Cols() * cell_width;
+  auto height = recording->Rows() * cell_height;
+
+  std::vector<double> frames;
+  auto start = std::chrono::steady_clock::now();
+  while (term->IsReplaying()) {
+    auto begin = std::chrono::steady_clock::now();
+    term->RenderCpu(width, height);
+    auto end = std::chrono::steady_clock::now();
+    frames.push_back(
+        std::chrono::duration<double, std::milli>(end - begin).count());
+  }
+  auto total =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  std::sort(frames.begin(), frames.end());
+  auto percentile = [&frames](double p) {
+    if (frames.empty()) {
+      return 0.0;
+    }
+    return frames[std::min(frames.size() - 1,
+                           static_cast<size_t>(p * frames.size()))];
+  };
+  printf("{\"frames\": %zu, \"bytes\": %zu, \"seconds\": %.6f, "
+         "\"mb_per_sec\": %.3f, \"frame_ms_p50\": %.4f, "
+         "\"frame_ms_p99\": %.4f, \"frame_ms_max\": %.4f}\n",
+         frames.size(), total_bytes, total,
+         total > 0 ? total_bytes / total / 1e6 : 0.0, percentile(0.5),
+         percentile(0.99), frames.empty() ? 0.0 : frames.back());
+  return 0;
+}
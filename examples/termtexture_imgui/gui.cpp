@@ -162,10 +162,19 @@ bool Gui::Initialize(GLFWwindow *window, std::string_view glsl_version,
         }
       }
 
+      // mouse wheel to scrollback. the last item is the fbo image
+      {
+        auto &io = ImGui::GetIO();
+        if (io.MouseWheel != 0 && ImGui::IsItemHovered()) {
+          term->Scroll(io.MouseWheel * 3);
+        }
+      }
+
       term->Render(width, height, time);
     };
 
-    auto fbo_window = FboWindow::Create("text", fbo_render);
+    // text rendering does not use depth
+    auto fbo_window = FboWindow::Create("text", fbo_render, false);
     windows_.push_back({
         .on_show = [fbo_window](bool *p_open) { fbo_window->show(p_open); },
         .use_show = false,
@@ -174,6 +183,13 @@ bool Gui::Initialize(GLFWwindow *window, std::string_view glsl_version,
               fbo_window->update(time);
             },
     });
+
+    windows_.push_back({
+        .on_show =
+            [term](bool *p_open) {
+              frame_stats_window(term->Stats(), p_open);
+            },
+    });
   }
 
   return true;
@@ -1,3 +1,4 @@
+#include <frame_stats.h>
 #include <gui_widgets.h>
 #include <imgui.h>
 #include <imgui_internal.h>
@@ -15,6 +16,51 @@ void another_window(bool *p_open) {
   ImGui::End();
 }
 
+void frame_stats_window(const FrameStats &stats, bool *p_open) {
+  ImGui::SetNextWindowBgAlpha(0.35f);
+  auto flags = ImGuiWindowFlags_NoDecoration |
+               ImGuiWindowFlags_AlwaysAutoResize |
+               ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+  if (!ImGui::Begin("frame stats", p_open, flags)) {
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Text("%zu frames. ms p50 / p95 / p99 / max", FrameStats::FRAMES);
+  if (ImGui::BeginTable("stages", 3, ImGuiTableFlags_RowBg)) {
+    ImGui::TableSetupColumn("stage");
+    ImGui::TableSetupColumn("cpu");
+    ImGui::TableSetupColumn("gpu");
+    ImGui::TableHeadersRow();
+    for (int i = 0; i < static_cast<int>(FrameStage::Count); ++i) {
+      auto stage = static_cast<FrameStage>(i);
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(FrameStageName(stage));
+      for (auto gpu : {false, true}) {
+        ImGui::TableNextColumn();
+        auto p = stats.Percentiles(stage, gpu);
+        if (p.samples) {
+          ImGui::Text("%.3f / %.3f / %.3f / %.3f", p.p50, p.p95, p.p99,
+                      p.max);
+        }
+        if (gpu && stats.GpuDropped(stage)) {
+          ImGui::SameLine();
+          ImGui::Text("(%llu dropped)", static_cast<unsigned long long>(
+                                            stats.GpuDropped(stage)));
+        }
+      }
+    }
+    ImGui::EndTable();
+  }
+
+  float frames[FrameStats::FRAMES];
+  auto n = stats.Samples(FrameStage::Frame, false, frames);
+  ImGui::PlotLines("frame", frames, static_cast<int>(n), 0, nullptr, 0.0f,
+                   FLT_MAX, ImVec2(0, 60));
+  ImGui::End();
+}
+
 void simple_window::operator()(bool *) {
 
   static float f = 0.0f;
@@ -51,25 +97,28 @@ void simple_window::operator()(bool *) {
 //
 // FboWindow
 //
-FboWindow::FboWindow(std::string_view name, const RenderFunc &render)
-    : name_(name), fbo_(new glo::FboRenderer), render_(render) {}
+FboWindow::FboWindow(std::string_view name, const RenderFunc &render,
+                     bool use_depth)
+    : name_(name), fbo_(new glo::FboRenderer(use_depth)), render_(render) {}
 
 FboWindow::~FboWindow() {}
 
 std::shared_ptr<FboWindow> FboWindow::Create(std::string_view name,
-                                             const RenderFunc &render) {
-  return std::shared_ptr<FboWindow>(new FboWindow(name, render));
+                                             const RenderFunc &render,
+                                             bool use_depth) {
+  return std::shared_ptr<FboWindow>(new FboWindow(name, render, use_depth));
 }
 
 void FboWindow::render_fbo(float x, float y, float w, float h,
                            std::chrono::nanoseconds time) {
   assert(w);
   assert(h);
-  auto texture =
+  auto region =
       fbo_->Begin(static_cast<int>(w), static_cast<int>(h), clear_color_);
-  if (texture) {
-    ImGui::ImageButton(reinterpret_cast<ImTextureID>(texture), {w, h}, {0, 1},
-                       {1, 0}, 0, bg_, tint_);
+  if (region.texture) {
+    // fbo is allocated in bucket size. use rendered sub-region
+    ImGui::ImageButton(reinterpret_cast<ImTextureID>(region.texture), {w, h},
+                       {0, region.v}, {region.u, 0}, 0, bg_, tint_);
     ImGui::ButtonBehavior(ImGui::GetCurrentContext()->LastItemData.Rect,
                           ImGui::GetCurrentContext()->LastItemData.ID, 0, 0,
                           ImGuiButtonFlags_MouseButtonMiddle |
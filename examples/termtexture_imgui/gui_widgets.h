@@ -8,6 +8,10 @@
 
 void another_window(bool *p_open);
 
+class FrameStats;
+// per-stage percentiles as an overlay
+void frame_stats_window(const FrameStats &stats, bool *p_open);
+
 struct simple_window {
   std::string name_;
   bool *show_demo_window_;
@@ -32,14 +36,15 @@ class FboWindow {
   RenderFunc render_;
   std::chrono::nanoseconds time_;
 
-  FboWindow(std::string_view name, const RenderFunc &render);
+  FboWindow(std::string_view name, const RenderFunc &render, bool use_depth);
 
 public:
   ~FboWindow();
   FboWindow(const FboWindow &) = delete;
   FboWindow &operator=(const FboWindow &) = delete;
   static std::shared_ptr<FboWindow> Create(std::string_view name,
-                                           const RenderFunc &render);
+                                           const RenderFunc &render,
+                                           bool use_depth = true);
   void show(bool *p_open);
   void update(std::chrono::nanoseconds time) { time_ = time; }
 
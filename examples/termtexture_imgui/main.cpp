@@ -1,6 +1,8 @@
 #include "glfw_window.h"
 #include "gui.h"
 #include <glo.h>
+#include <glo/program_cache.h>
+#include <glo/shader.h>
 #include <plog/Appenders/ColorConsoleAppender.h>
 #include <plog/Formatters/TxtFormatter.h>
 #include <plog/Init.h>
@@ -57,6 +59,10 @@ int main(int argc, char **argv) {
   }
 
   glo::InitiazlieGlew();
+  auto cache_dir = std::filesystem::temp_directory_path() / "termtexture";
+  glo::ProgramCache::SetCurrent(
+      glo::ProgramCache::Create(cache_dir / "programs"));
+  glo::SetSpirvCacheDir((cache_dir / "spirv").string().c_str());
   Gui gui;
   if (!gui.Initialize(window_handle, window.glsl_version(), fontfile)) {
     return 2;
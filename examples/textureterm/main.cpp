@@ -2,12 +2,17 @@
 #include "vterm_keycodes.h"
 #include <GLFW/glfw3.h>
 #include <glo.h>
+#include <glo/program_cache.h>
+#include <glo/shader.h>
+#include <glo/state_cache.h>
 #include <plog/Appenders/ColorConsoleAppender.h>
 #include <plog/Formatters/TxtFormatter.h>
 #include <plog/Init.h>
 #include <plog/Log.h>
+#include <pty_write_queue.h>
 #include <stdexcept>
 #include <termtexture.h>
+#include <trace.h>
 
 namespace plog {
 class MyFormatter {
@@ -142,12 +147,29 @@ static std::optional<VTermKey> to_vterm_key(int glfw_key) {
   }
 }
 
+// streamed in the background. escape cancels
+static std::shared_ptr<common_pty::WriteStream> g_paste;
+
 static void key_callback(GLFWwindow *window, int key, int scancode, int action,
                          int mods) {
 
   auto term = (termtexture::TermTexture *)glfwGetWindowUserPointer(window);
   auto vterm_mod = to_vterm_mod(mods);
   if (action == GLFW_PRESS) {
+    if (key == GLFW_KEY_V && (mods & GLFW_MOD_CONTROL) &&
+        (mods & GLFW_MOD_SHIFT)) {
+      if (auto text = glfwGetClipboardString(window)) {
+        g_paste = term->Paste(text);
+      }
+      return;
+    }
+    if (key == GLFW_KEY_ESCAPE && g_paste && !g_paste->IsDone()) {
+      PLOG_INFO << "cancel paste at " << g_paste->Written() << "/"
+                << g_paste->Size();
+      g_paste->Cancel();
+      return;
+    }
+
     switch (key) {
     case GLFW_KEY_KP_0:
     case GLFW_KEY_KP_1:
@@ -207,6 +229,13 @@ static void key_callback(GLFWwindow *window, int key, int scancode, int action,
   }
 }
 
+static void scroll_callback(GLFWwindow *window, double xoffset,
+                            double yoffset) {
+  auto term = (termtexture::TermTexture *)glfwGetWindowUserPointer(window);
+  // 3 rows per notch. touchpads send fractional offsets
+  term->Scroll(yoffset * 3);
+}
+
 // static void character_callback(GLFWwindow *window, unsigned int codepoint) {
 //   auto term = (termtexture::TermTexture *)glfwGetWindowUserPointer(window);
 //   auto mod = VTermModifier::VTERM_MOD_NONE;
@@ -224,6 +253,28 @@ int main(int argc, char **argv) {
   if (argc > 1) {
     fontfile = argv[1];
   }
+  // textureterm font.ttf [--record file | --replay file] [--trace file.json]
+  //   [--loop wait | poll] [--latency low]
+  // wait renders only on input, output or resize. poll renders every vsync.
+  // low waits for the echo of a key and presents it without vsync
+  std::string record;
+  std::string replay;
+  std::string trace;
+  bool wait = true;
+  bool low_latency = false;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (std::string(argv[i]) == "--record") {
+      record = argv[i + 1];
+    } else if (std::string(argv[i]) == "--replay") {
+      replay = argv[i + 1];
+    } else if (std::string(argv[i]) == "--trace") {
+      trace = argv[i + 1];
+    } else if (std::string(argv[i]) == "--loop") {
+      wait = std::string(argv[i + 1]) != "poll";
+    } else if (std::string(argv[i]) == "--latency") {
+      low_latency = std::string(argv[i + 1]) == "low";
+    }
+  }
   static plog::ColorConsoleAppender<plog::MyFormatter> consoleAppender;
   plog::init(plog::verbose, &consoleAppender);
   PLOG_INFO << "start textureterm...";
@@ -234,9 +285,16 @@ int main(int argc, char **argv) {
     return 1;
   }
   glfwSetKeyCallback(window_handle, key_callback);
+  glfwSetScrollCallback(window_handle, scroll_callback);
   // glfwSetCharCallback(window_handle, character_callback);
 
   glo::InitiazlieGlew();
+  // skip shader compilation from the second launch
+  auto cache_dir = std::filesystem::temp_directory_path() / "termtexture";
+  glo::ProgramCache::SetCurrent(
+      glo::ProgramCache::Create(cache_dir / "programs"));
+  // keyed on the shader source. compiled again when the source changes
+  glo::SetSpirvCacheDir((cache_dir / "spirv").string().c_str());
   auto term = termtexture::TermTexture::Create();
   uint16_t cell_width = 15;
   uint16_t cell_height = 30;
@@ -245,24 +303,91 @@ int main(int argc, char **argv) {
     return 2;
   }
   glfwSetWindowUserPointer(window_handle, term.get());
+  // wakes WaitEvents from the pty reader thread
+  term->SetWake(&Window::Wake);
+  if (low_latency) {
+    PLOG_INFO << "adaptive vsync: " << window.SetLowLatency(true);
+    term->SetLowLatency(true);
+  }
 
-  {
+  if (!replay.empty()) {
+    if (!term->StartReplay(replay)) {
+      PLOG_ERROR << "StartReplay: " << replay;
+      return 3;
+    }
+  } else {
     auto [width, height] = window.FrameBufferSize();
     auto cmd = "cmd.exe";
     if (!term->Launch(cmd, term->TermSizeFromTextureSize(width, height))) {
       PLOG_ERROR << "Launch: " << cmd;
       return 3;
     }
+    if (!record.empty() && !term->StartRecording(record)) {
+      PLOG_ERROR << "StartRecording: " << record;
+    }
+  }
+
+  if (!trace.empty()) {
+    tracing::Start();
   }
 
   float clear_color[] = {0, 0, 0, 0};
-  while (auto time = window.BeginFrame(clear_color)) {
-    if (term->IsClosed()) {
-      break;
+  if (wait) {
+    // a realtime replay is paced by a timer instead of pty wakes
+    while (window.WaitEvents(term->IsReplaying() ? 1.0 / 60 : -1)) {
+      if (term->IsClosed()) {
+        break;
+      }
+      // key callbacks ran in WaitEvents
+      auto dirty = term->Poll();
+      if (!dirty && !window.IsDamaged()) {
+        continue;
+      }
+      auto time = window.Clear(clear_color);
+      auto [width, height] = window.FrameBufferSize();
+      term->Render(width, height, time);
+      window.EndFrame();
+      glo::StateCache::Current().EndFrame();
+      term->Presented();
     }
-    auto [width, height] = window.FrameBufferSize();
-    term->Render(width, height, time.value());
-    window.EndFrame();
+  } else {
+    while (auto time = window.BeginFrame(clear_color)) {
+      if (term->IsClosed()) {
+        break;
+      }
+      auto [width, height] = window.FrameBufferSize();
+      term->Render(width, height, time.value());
+      window.EndFrame();
+      glo::StateCache::Current().EndFrame();
+      term->Presented();
+    }
+  }
+
+  if (auto cache = glo::ProgramCache::Current()) {
+    auto &stats = cache->Stats();
+    PLOG_INFO << "program cache: " << stats.hits << " hits, " << stats.misses
+              << " misses, " << stats.rejected << " rejected";
+  }
+
+  auto &gl_state = glo::StateCache::Current();
+  if (gl_state.Frames()) {
+    auto &total = gl_state.Total();
+    PLOG_INFO << "gl state: " << total.issued / gl_state.Frames()
+              << " calls, " << total.elided / gl_state.Frames()
+              << " elided per frame";
+  }
+
+  auto latency = term->Stats().Percentiles(FrameStage::KeyToPresent);
+  if (latency.samples) {
+    PLOG_INFO << "key to present: p50 " << latency.p50 << "ms, p95 "
+              << latency.p95 << "ms, max " << latency.max << "ms ("
+              << latency.samples << " keys)";
+  }
+
+  if (!trace.empty()) {
+    tracing::Stop();
+    // open in chrome://tracing or ui.perfetto.dev
+    tracing::WriteChromeJson(trace);
   }
 
   return 0;
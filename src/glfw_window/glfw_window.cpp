@@ -2,6 +2,8 @@
 #include "plog/Log.h"
 #include <GLFW/glfw3.h> // Will drag system OpenGL headers
 #include <chrono>
+#include <glo/fbo.h>
+#include <glo/state_cache.h>
 #include <optional>
 #include <plog/Logger.h>
 #include <ratio>
@@ -11,6 +13,10 @@ static void glfw_error_callback(int error, const char *description) {
   fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
+// the window contents were lost. e.g. uncovered
+static bool g_refresh = true;
+static void glfw_refresh_callback(GLFWwindow *window) { g_refresh = true; }
+
 Window::Window() {
   // Setup window
   glfwSetErrorCallback(glfw_error_callback);
@@ -20,6 +26,13 @@ Window::Window() {
 }
 
 Window::~Window() {
+  if (fbo_pool_) {
+    fbo_pool_->Clear();
+    glo::FboPool::SetDefault(nullptr);
+  }
+  if (gl_state_) {
+    glo::StateCache::SetCurrent(nullptr);
+  }
   glfwDestroyWindow(window_);
   glfwTerminate();
 }
@@ -55,6 +68,11 @@ GLFWwindow *Window::CreaeWindow(int width, int height, const char *title) {
   }
 
   glfwMakeContextCurrent(window_);
+  gl_state_ = glo::StateCache::Create();
+  glo::StateCache::SetCurrent(gl_state_.get());
+  fbo_pool_ = std::make_shared<glo::FboPool>();
+  glo::FboPool::SetDefault(fbo_pool_);
+  glfwSetWindowRefreshCallback(window_, glfw_refresh_callback);
 
   PLOG_INFO << "GL_VERSION: " << glGetString(GL_VERSION);
   PLOG_INFO << "GL_VENDOR: " << glGetString(GL_VENDOR);
@@ -87,7 +105,46 @@ Window::BeginFrame(const float clear_color[4]) {
   // and hide them from your application based on those two flags.
   glfwPollEvents();
 
+  return Clear(clear_color);
+}
+
+void Window::EndFrame() { glfwSwapBuffers(window_); }
+
+bool Window::WaitEvents(double timeout) {
+  if (timeout < 0) {
+    glfwWaitEvents();
+  } else {
+    glfwWaitEventsTimeout(timeout);
+  }
+  return !glfwWindowShouldClose(window_);
+}
+
+void Window::Wake() { glfwPostEmptyEvent(); }
+
+bool Window::IsDamaged() const {
+  if (g_refresh) {
+    return true;
+  }
+  auto [display_w, display_h] = FrameBufferSize();
+  return display_w != width_ || display_h != height_;
+}
+
+bool Window::SetLowLatency(bool enable) {
+  if (!enable) {
+    glfwSwapInterval(1);
+    return false;
+  }
+  auto adaptive = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                  glfwExtensionSupported("GLX_EXT_swap_control_tear");
+  glfwSwapInterval(adaptive ? -1 : 0);
+  return adaptive;
+}
+
+std::chrono::nanoseconds Window::Clear(const float clear_color[4]) {
   auto [display_w, display_h] = FrameBufferSize();
+  width_ = display_w;
+  height_ = display_h;
+  g_refresh = false;
 
   // render
   glViewport(0, 0, display_w, display_h);
@@ -98,5 +155,3 @@ Window::BeginFrame(const float clear_color[4]) {
   std::chrono::duration<double, std::ratio<1, 1>> time(glfwGetTime());
   return std::chrono::duration_cast<std::chrono::nanoseconds>(time);
 }
-
-void Window::EndFrame() { glfwSwapBuffers(window_); }
@@ -1,13 +1,25 @@
 #pragma once
 #include <chrono>
+#include <memory>
 #include <optional>
 #include <ratio>
 #include <string>
 #include <string_view>
 
+namespace glo {
+class FboPool;
+class StateCache;
+}
+
 class Window {
   struct GLFWwindow *window_ = nullptr;
   std::string glsl_version_;
+  // size at the last Clear
+  int width_ = 0;
+  int height_ = 0;
+  // freed before the context
+  std::shared_ptr<glo::FboPool> fbo_pool_;
+  std::shared_ptr<glo::StateCache> gl_state_;
 
 public:
   Window();
@@ -17,4 +29,19 @@ public:
   std::tuple<int, int> FrameBufferSize()const;
   std::optional<std::chrono::nanoseconds> BeginFrame(const float clear_color[4]);
   void EndFrame();
+
+  // event driven frames instead of BeginFrame.
+  // block until an event, Wake or timeout seconds. negative waits forever.
+  // false when the window should close
+  bool WaitEvents(double timeout = -1);
+  // wake WaitEvents from any thread
+  static void Wake();
+  // resized or exposed since the last Clear
+  bool IsDamaged() const;
+  // begin a frame after WaitEvents
+  std::chrono::nanoseconds Clear(const float clear_color[4]);
+  // present without waiting for the next vblank. adaptive vsync (tears only
+  // when late) if the driver has swap_control_tear, otherwise vsync off.
+  // false restores vsync. returns true if adaptive
+  bool SetLowLatency(bool enable);
 };
@@ -1,5 +1,7 @@
 #include "glo/fbo.h"
+#include "glo/state_cache.h"
 #include <GL/glew.h>
+#include <algorithm>
 
 namespace glo {
 
@@ -9,7 +11,7 @@ namespace glo {
 Fbo::Fbo(int width, int height, bool use_depth)
     : texture_(Texture::Create(width, height, GL_RGBA)) {
   glGenFramebuffers(1, &fbo_);
-  glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+  StateCache::Current().BindFramebuffer(fbo_);
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
                          texture_->Handle(), 0);
   unsigned int buf = GL_COLOR_ATTACHMENT0;
@@ -23,38 +25,101 @@ Fbo::Fbo(int width, int height, bool use_depth)
                               GL_RENDERBUFFER, depth_);
   }
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  StateCache::Current().BindFramebuffer(0);
   // LOGGER.debug(f'fbo: {self.fbo}, texture: {self.texture}, depth:
   // {self.depth}')
 }
 
 Fbo::~Fbo() {
   // LOGGER.debug(f'fbo: {self.fbo}')
-  glDeleteFramebuffers(1, &fbo_);
+  StateCache::Current().DeleteFramebuffer(fbo_);
+  if (depth_) {
+    glDeleteRenderbuffers(1, &depth_);
+  }
+}
+
+void Fbo::Bind() { StateCache::Current().BindFramebuffer(fbo_); }
+
+// unbound for real. the default framebuffer is drawn next
+void Fbo::Unbind() { StateCache::Current().BindFramebuffer(0); }
+
+//
+// FboPool
+//
+FboPool::FboPool(size_t max_free) : max_free_(max_free) {}
+FboPool::~FboPool() {}
+
+// weak. the context owner frees the pool while its context is alive
+static thread_local std::weak_ptr<FboPool> t_default;
+
+std::shared_ptr<FboPool> FboPool::Default() {
+  if (auto pool = t_default.lock()) {
+    return pool;
+  }
+  return std::make_shared<FboPool>();
+}
+
+void FboPool::SetDefault(const std::shared_ptr<FboPool> &pool) {
+  t_default = pool;
 }
 
-void Fbo::Bind() { glBindFramebuffer(GL_FRAMEBUFFER, fbo_); }
+int FboPool::BucketSize(int size) {
+  int bucket = 64;
+  while (bucket < size) {
+    if (bucket + bucket / 2 >= size) {
+      return bucket + bucket / 2;
+    }
+    bucket *= 2;
+  }
+  return bucket;
+}
 
-void Fbo::Unbind() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+std::shared_ptr<Fbo> FboPool::Acquire(int width, int height, bool use_depth) {
+  auto w = BucketSize(width);
+  auto h = BucketSize(height);
+  auto found = std::find_if(free_.begin(), free_.end(), [=](auto &fbo) {
+    return fbo->Texture()->Width() == w && fbo->Texture()->Height() == h &&
+           fbo->HasDepth() == use_depth;
+  });
+  if (found != free_.end()) {
+    auto fbo = *found;
+    free_.erase(found);
+    return fbo;
+  }
+  return std::make_shared<Fbo>(w, h, use_depth);
+}
+
+void FboPool::Release(const std::shared_ptr<Fbo> &fbo) {
+  if (!fbo) {
+    return;
+  }
+  free_.push_back(fbo);
+  if (free_.size() > max_free_) {
+    // drop oldest
+    free_.erase(free_.begin());
+  }
+}
 
 //
 // FboRenderer
 //
-FboRenderer::FboRenderer() {}
-FboRenderer::~FboRenderer() {}
-GLuint FboRenderer::Begin(int width, int height, const float color[4]) {
+FboRenderer::FboRenderer(bool use_depth, const std::shared_ptr<FboPool> &pool)
+    : pool_(pool), use_depth_(use_depth) {}
+FboRenderer::~FboRenderer() { pool_->Release(fbo_); }
+FboRegion FboRenderer::Begin(int width, int height, const float color[4]) {
   if (width == 0 || height == 0) {
-    return 0;
+    return {};
   }
 
   if (fbo_) {
-    if (fbo_->Texture()->Width() != width ||
-        fbo_->Texture()->Height() != height) {
+    if (fbo_->Texture()->Width() != FboPool::BucketSize(width) ||
+        fbo_->Texture()->Height() != FboPool::BucketSize(height)) {
+      pool_->Release(fbo_);
       fbo_ = nullptr;
     }
   }
   if (!fbo_) {
-    fbo_ = std::make_shared<glo::Fbo>(width, height);
+    fbo_ = pool_->Acquire(width, height, use_depth_);
   }
 
   fbo_->Bind();
@@ -62,10 +127,18 @@ GLuint FboRenderer::Begin(int width, int height, const float color[4]) {
   glScissor(0, 0, width, height);
   glClearColor(color[0] * color[3], color[1] * color[3], color[2] * color[3],
                color[3]);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glClearDepth(1.0);
-  glDepthFunc(GL_LESS);
-  return fbo_->Texture()->Handle();
+  if (use_depth_) {
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  } else {
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+  return {
+      .texture = fbo_->Texture()->Handle(),
+      .u = static_cast<float>(width) / fbo_->Texture()->Width(),
+      .v = static_cast<float>(height) / fbo_->Texture()->Height(),
+  };
 }
 void FboRenderer::End() { fbo_->Unbind(); }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "texture.h"
 #include <memory>
+#include <vector>
 
 namespace glo {
 class Fbo {
@@ -11,18 +12,60 @@ class Fbo {
 public:
   Fbo(int width, int height, bool use_depth = true);
   ~Fbo();
+  Fbo(const Fbo &) = delete;
+  Fbo &operator=(const Fbo &) = delete;
   std::shared_ptr<glo::Texture> Texture() { return texture_; }
+  bool HasDepth() const { return depth_ != 0; }
   void Bind();
   void Unbind();
 };
 
+/// Recycles Fbo in size buckets (64, 96, 128, 192, 256, 384...).
+/// A resize inside the same bucket reuses the Fbo, and an Fbo released by one
+/// FboRenderer can be picked up by another.
+/// The owner of a GL context (Window, HeadlessContext) keeps one and clears it
+/// before the context is destroyed.
+class FboPool {
+  std::vector<std::shared_ptr<Fbo>> free_;
+  size_t max_free_;
+
+public:
+  FboPool(size_t max_free = 8);
+  ~FboPool();
+  FboPool(const FboPool &) = delete;
+  FboPool &operator=(const FboPool &) = delete;
+  // the pool of the context current on this thread. a new pool, owned by its
+  // FboRenderer, if the context owner has not set one
+  static std::shared_ptr<FboPool> Default();
+  // by the context owner when the context is made current. nullptr before it
+  // is destroyed
+  static void SetDefault(const std::shared_ptr<FboPool> &pool);
+  static int BucketSize(int size);
+  std::shared_ptr<Fbo> Acquire(int width, int height, bool use_depth);
+  void Release(const std::shared_ptr<Fbo> &fbo);
+  // needs the GL context that made the Fbo current
+  void Clear() { free_.clear(); }
+};
+
+struct FboRegion {
+  uint32_t texture = 0;
+  // rendered area in uv. (0, 0)-(u, v)
+  float u = 0;
+  float v = 0;
+};
+
 class FboRenderer {
+  std::shared_ptr<glo::FboPool> pool_;
   std::shared_ptr<glo::Fbo> fbo_;
+  bool use_depth_;
 
 public:
-  FboRenderer();
+  FboRenderer(bool use_depth = true,
+              const std::shared_ptr<FboPool> &pool = FboPool::Default());
   ~FboRenderer();
-  uint32_t Begin(int width, int height, const float color[4]);
+  FboRenderer(const FboRenderer &) = delete;
+  FboRenderer &operator=(const FboRenderer &) = delete;
+  FboRegion Begin(int width, int height, const float color[4]);
   void End();
 };
 
@@ -0,0 +1,54 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+namespace glo {
+
+struct ShaderSources;
+
+struct ProgramCacheStats {
+  uint32_t hits = 0;
+  // no file, or made by another driver or other sources
+  uint32_t misses = 0;
+  // the driver refused the binary. compiled again
+  uint32_t rejected = 0;
+  uint32_t stores = 0;
+};
+
+/// Linked program binaries on disk, by glGetProgramBinary/glProgramBinary.
+/// A file is keyed by the hash of the sources and records the GL vendor,
+/// renderer and version. A binary from another driver is a miss and the
+/// program is compiled and stored again.
+/// ShaderProgram::Create uses the current cache.
+class ProgramCache {
+  std::filesystem::path dir_;
+  // GL_VENDOR, GL_RENDERER and GL_VERSION
+  std::string driver_;
+  ProgramCacheStats stats_;
+
+  ProgramCache(const std::filesystem::path &dir, const std::string &driver);
+
+public:
+  ~ProgramCache();
+  ProgramCache(const ProgramCache &) = delete;
+  ProgramCache &operator=(const ProgramCache &) = delete;
+  // needs a current GL context. nullptr if the driver has no binary format or
+  // dir can not be created
+  static std::shared_ptr<ProgramCache> Create(const std::filesystem::path &dir);
+  static void SetCurrent(const std::shared_ptr<ProgramCache> &cache);
+  static ProgramCache *Current();
+
+  uint64_t Key(const ShaderSources &src) const;
+  // glProgramBinary. false on a miss or if the driver refuses it
+  bool Load(uint32_t program, uint64_t key);
+  // after a successful link
+  void Store(uint32_t program, uint64_t key);
+  const ProgramCacheStats &Stats() const { return stats_; }
+
+private:
+  std::filesystem::path Path(uint64_t key) const;
+};
+
+} // namespace glo
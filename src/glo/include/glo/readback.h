@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+// GLsync
+struct __GLsync;
+
+namespace glo {
+
+/// Reads RGBA8 pixels of the bound read framebuffer through a ring of pixel
+/// pack buffers. Read() only queues the copy on the GPU and TryGet() maps
+/// the buffer after its fence has signaled, so the caller does not stall.
+class PixelReader {
+  struct Slot {
+    uint32_t pbo = 0;
+    uint32_t capacity = 0;
+    __GLsync *fence = nullptr;
+    int width = 0;
+    int height = 0;
+  };
+  std::vector<Slot> slots_;
+  // oldest pending
+  size_t head_ = 0;
+  size_t pending_ = 0;
+
+  PixelReader(size_t depth);
+
+public:
+  ~PixelReader();
+  PixelReader(const PixelReader &) = delete;
+  PixelReader &operator=(const PixelReader &) = delete;
+  static std::shared_ptr<PixelReader> Create(size_t depth = 3);
+  size_t Pending() const { return pending_; }
+  // false if all slots are in flight
+  bool Read(int x, int y, int width, int height);
+  // oldest finished read. rows are bottom to top.
+  // false if nothing is ready, or wait is false and the GPU is not done.
+  bool TryGet(std::vector<uint8_t> &rgba, int *width, int *height,
+              bool wait = false);
+};
+
+} // namespace glo
@@ -1,10 +1,18 @@
 #pragma once
 #include <memory>
 #include <optional>
+#include <span>
 #include <stdint.h>
 
 namespace glo {
 
+// layout(constant_id = id) const of a SPIR-V stage. value holds the bits of
+// the bool, int, uint or float
+struct SpecializationConstant {
+  uint32_t id;
+  uint32_t value;
+};
+
 class ShaderCompile {
 
   // GL_VERTEX_SHADER, GL_FRAGMENT_SHADER
@@ -19,14 +27,29 @@ public:
   static std::shared_ptr<ShaderCompile> VertexShader();
   static std::shared_ptr<ShaderCompile> FragmentShader();
   static std::shared_ptr<ShaderCompile> GeometryShader();
-  bool Compile(const char *src, bool use_spirv);
+  bool Compile(const char *src, bool use_spirv,
+               std::span<const SpecializationConstant> constants = {});
+  // SPIR-V from spirv_util
+  bool LoadSpirv(const unsigned int *spirv, unsigned int size,
+                 std::span<const SpecializationConstant> constants = {});
+
+private:
+  bool CompileStatus();
 };
 
+// SPIR-V is memoized in memory by spirv_util. also keep it in dir.
+// nullptr disables
+void SetSpirvCacheDir(const char *dir);
+
 struct ShaderSources {
   const char *vs = nullptr;
   const char *fs = nullptr;
   const char *gs = nullptr;
   bool use_spirv = true;
+  // per stage, SPIR-V only. a constant the stage does not declare fails it
+  std::span<const SpecializationConstant> vs_constants = {};
+  std::span<const SpecializationConstant> fs_constants = {};
+  std::span<const SpecializationConstant> gs_constants = {};
 };
 
 struct Shaders {
@@ -51,6 +74,9 @@ public:
   std::optional<uint32_t> AttributeLocation(const char *name);
   void SetUniformMatrix(const char *name, const float m[16]);
   void SetUBO(int binding_point, uint32_t ubo);
+
+private:
+  static bool CompileSpirv(const ShaderSources &src, Shaders *shaders);
 };
 
 } // namespace glo
@@ -0,0 +1,134 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+
+namespace glo {
+
+struct StateCounters {
+  // GL calls made
+  uint64_t issued = 0;
+  // GL calls skipped. the state was already set
+  uint64_t elided = 0;
+};
+
+/// Last known binds and capabilities of a GL context. One per context, owned
+/// by the context owner (Window, HeadlessContext) and made current with it.
+/// glo binds through the current one and skips calls that would not change
+/// anything. Unbind of array and uniform buffers, vertex arrays, programs and
+/// textures leaves the object bound, so binding it again is skipped too.
+/// Pixel pack and unpack buffers and framebuffers are unbound for real.
+/// GL calls outside glo are not seen. Invalidate after them. The owners
+/// invalidate when they make their context current.
+class StateCache {
+  struct IndexedBuffer {
+    uint32_t buffer;
+    // size 0 for the whole buffer
+    uint64_t offset;
+    uint64_t size;
+    bool operator==(const IndexedBuffer &) const = default;
+  };
+
+  // by target
+  std::unordered_map<uint32_t, uint32_t> buffers_;
+  // by target and index
+  std::unordered_map<uint64_t, IndexedBuffer> indexed_buffers_;
+  // by unit and target
+  std::unordered_map<uint64_t, uint32_t> textures_;
+  std::unordered_map<uint32_t, bool> caps_;
+  std::optional<uint32_t> active_texture_;
+  std::optional<uint32_t> vertex_array_;
+  std::optional<uint32_t> program_;
+  std::optional<uint32_t> framebuffer_;
+  std::optional<std::pair<uint32_t, uint32_t>> blend_func_;
+
+  StateCounters frame_;
+  StateCounters last_frame_;
+  StateCounters total_;
+  uint64_t frames_ = 0;
+
+  StateCache() = default;
+
+public:
+  StateCache(const StateCache &) = delete;
+  StateCache &operator=(const StateCache &) = delete;
+  static std::shared_ptr<StateCache> Create();
+  // by the context owner when its context is made current on this thread.
+  // nullptr before the context is destroyed
+  static void SetCurrent(StateCache *cache);
+  // the cache set by SetCurrent. without one, a cache that forgets
+  // everything at each call, so every call is issued
+  static StateCache &Current();
+
+  void BindBuffer(uint32_t target, uint32_t buffer);
+  // also binds the generic target, as GL does
+  void BindBufferBase(uint32_t target, uint32_t index, uint32_t buffer);
+  void BindBufferRange(uint32_t target, uint32_t index, uint32_t buffer,
+                       uint64_t offset, uint64_t size);
+  void BindVertexArray(uint32_t vertex_array);
+  // GL_TEXTURE0 + n
+  void ActiveTexture(uint32_t unit);
+  // to the active unit
+  void BindTexture(uint32_t target, uint32_t texture);
+  // GL_FRAMEBUFFER. draw and read
+  void BindFramebuffer(uint32_t framebuffer);
+  void UseProgram(uint32_t program);
+  void Enable(uint32_t cap);
+  void Disable(uint32_t cap);
+  void BlendFunc(uint32_t src, uint32_t dst);
+  // an unbind that is skipped. see above
+  void Release() { Elided(); }
+
+  // glDelete*. GL unbinds a deleted object from the current context
+  void DeleteBuffer(uint32_t buffer);
+  void DeleteVertexArray(uint32_t vertex_array);
+  void DeleteTexture(uint32_t texture);
+  void DeleteFramebuffer(uint32_t framebuffer);
+  void DeleteProgram(uint32_t program);
+
+  // forget everything. the next calls are issued
+  void Invalidate();
+
+  // counters of the frame so far
+  const StateCounters &Frame() const { return frame_; }
+  // counters of the last ended frame
+  const StateCounters &LastFrame() const { return last_frame_; }
+  const StateCounters &Total() const { return total_; }
+  uint64_t Frames() const { return frames_; }
+  void EndFrame();
+
+private:
+  void Issued() {
+    ++frame_.issued;
+    ++total_.issued;
+  }
+  void Elided() {
+    ++frame_.elided;
+    ++total_.elided;
+  }
+  // true if the call is needed. updates the cache
+  template <typename T, typename V> bool Set(std::optional<T> &slot, V value) {
+    if (slot && *slot == value) {
+      Elided();
+      return false;
+    }
+    slot = value;
+    Issued();
+    return true;
+  }
+  template <typename K, typename V>
+  bool Set(std::unordered_map<K, V> &map, K key, V value) {
+    auto [found, inserted] = map.emplace(key, value);
+    if (!inserted && found->second == value) {
+      Elided();
+      return false;
+    }
+    found->second = value;
+    Issued();
+    return true;
+  }
+};
+
+} // namespace glo
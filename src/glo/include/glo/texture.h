@@ -6,7 +6,7 @@ namespace glo {
 class Texture {
   int width_;
   int height_;
-  // GL_RGBA(32bit) or GL_RED(8bit graysclale)
+  // GL_RED(8bit graysclale), GL_RG, GL_RGB or GL_RGBA. 8bit per channel
   int pixel_type_;
   uint32_t handle_;
 
@@ -21,6 +21,11 @@ public:
   uint32_t Handle() const { return handle_; }
   int Width() const { return width_; }
   int Height() const { return height_; }
+  int PixelType() const { return pixel_type_; }
+  // 0 for a format not listed above
+  int BytesPerPixel() const;
+  // data is the whole texture image, Width() pixels per row. the w x h rect
+  // at x, y is read from it. TextureUploader::Upload takes the rect alone
   void Update(int x, int y, int w, int h, const uint8_t *data);
   void Bind();
   void Unbind();
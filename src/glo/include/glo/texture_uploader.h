@@ -0,0 +1,61 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+// GLsync
+struct __GLsync;
+
+namespace glo {
+
+class Texture;
+
+/// Texture uploads through a ring of pixel unpack buffers. Upload copies the
+/// pixels into a mapped buffer and queues glTexSubImage2D from it, so the
+/// driver does not copy from client memory and the caller does not wait for
+/// the GPU to finish with the buffer. A buffer is reused after its fence.
+/// Post queues pixels, from any thread, for the next Flush on the GL thread.
+/// GlFont posts an atlas that found every buffer busy instead of stalling in
+/// Texture::Update.
+class TextureUploader {
+  struct Slot {
+    uint32_t pbo = 0;
+    uint32_t capacity = 0;
+    __GLsync *fence = nullptr;
+  };
+  struct Posted {
+    std::weak_ptr<Texture> texture;
+    int x;
+    int y;
+    int w;
+    int h;
+    std::vector<uint8_t> pixels;
+  };
+  std::vector<Slot> slots_;
+  size_t next_ = 0;
+  std::mutex mutex_;
+  std::vector<Posted> posted_;
+
+  TextureUploader(size_t depth);
+
+public:
+  ~TextureUploader();
+  TextureUploader(const TextureUploader &) = delete;
+  TextureUploader &operator=(const TextureUploader &) = delete;
+  static std::shared_ptr<TextureUploader> Create(size_t depth = 3);
+  // on the GL thread. data is the w x h rect alone, w pixels per row of the
+  // texture format. Texture::Update reads the rect out of the whole image
+  // instead. false if every buffer is still read by the GPU, or for a format
+  // Texture::BytesPerPixel does not know. the caller may Post it
+  bool Upload(Texture &texture, int x, int y, int w, int h,
+              const uint8_t *data);
+  // any thread. pixels as for Upload. uploaded by the next Flush
+  void Post(const std::shared_ptr<Texture> &texture, int x, int y, int w,
+            int h, std::vector<uint8_t> pixels);
+  // on the GL thread, once a frame. what does not fit in a free buffer waits
+  // for the next. returns the number of uploads
+  size_t Flush();
+};
+
+} // namespace glo
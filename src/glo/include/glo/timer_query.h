@@ -0,0 +1,39 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace glo {
+
+/// GPU time of a command range by GL_TIME_ELAPSED queries.
+/// Queries are kept in a ring and read back only when available, a few
+/// frames later, so the caller does not stall.
+/// Only one GL_TIME_ELAPSED query can be active at a time.
+class TimerQuery {
+  std::vector<uint32_t> queries_;
+  // oldest pending
+  size_t head_ = 0;
+  size_t pending_ = 0;
+  bool active_ = false;
+  uint64_t dropped_ = 0;
+
+  TimerQuery(size_t depth);
+
+public:
+  ~TimerQuery();
+  TimerQuery(const TimerQuery &) = delete;
+  TimerQuery &operator=(const TimerQuery &) = delete;
+  static std::shared_ptr<TimerQuery> Create(size_t depth = 4);
+  size_t Pending() const { return pending_; }
+  // false if all queries are in flight, counted as dropped. End is ignored
+  // then
+  bool Begin();
+  void End();
+  // oldest finished query. false if none is available yet
+  bool TryGet(std::chrono::nanoseconds *elapsed);
+  // Begin calls that found the ring full
+  uint64_t Dropped() const { return dropped_; }
+};
+
+} // namespace glo
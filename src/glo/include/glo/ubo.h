@@ -1,6 +1,9 @@
 #pragma once
 #include <memory>
+#include <optional>
 #include <stdint.h>
+#include <string.h>
+#include <type_traits>
 
 namespace glo {
 class UBO {
@@ -18,15 +21,46 @@ public:
   void Unbind();
   void Upload(const void *data, uint32_t size);
   template <typename T> void Upload(const T &t) { Upload(&t, sizeof(T)); }
+  // into the storage of the last Upload
+  void SubUpload(uint32_t offset, const void *data, uint32_t size);
   void BindBase(int binding);
 };
 
+/// A UBO and its contents. Upload sends only the bytes that changed since the
+/// last Upload, and nothing if none did.
 template <typename T> struct TypedUBO {
+  static_assert(std::is_trivially_copyable_v<T>);
   std::shared_ptr<UBO> ubo;
   T buffer;
+  // the contents on the GPU
+  std::optional<T> uploaded;
 
-  void Initialize() { ubo = UBO::Create(); }
-  void Upload() { ubo->Upload(buffer); }
+  void Initialize() {
+    ubo = UBO::Create();
+    uploaded.reset();
+  }
+  void Upload() {
+    if (!uploaded) {
+      ubo->Upload(buffer);
+      uploaded = buffer;
+      return;
+    }
+    auto src = reinterpret_cast<const uint8_t *>(&buffer);
+    auto dst = reinterpret_cast<uint8_t *>(&*uploaded);
+    uint32_t begin = 0;
+    uint32_t end = sizeof(T);
+    while (begin < end && src[begin] == dst[begin]) {
+      ++begin;
+    }
+    while (end > begin && src[end - 1] == dst[end - 1]) {
+      --end;
+    }
+    if (begin == end) {
+      return;
+    }
+    ubo->SubUpload(begin, src + begin, end - begin);
+    memcpy(dst + begin, src + begin, end - begin);
+  }
   uint32_t Handle() { return ubo->Handle(); }
 };
 
@@ -0,0 +1,74 @@
+#pragma once
+#include <memory>
+#include <stdint.h>
+
+// GLsync
+struct __GLsync;
+
+namespace glo {
+
+struct UniformRange {
+  uint32_t buffer = 0;
+  uint32_t offset = 0;
+  uint32_t size = 0;
+  // segments the ring had left when this was pushed
+  uint64_t generation = 0;
+};
+
+/// One persistently mapped uniform buffer, sub-allocated for uniforms that
+/// change every frame. Push copies into the mapping and returns a range for
+/// glBindBufferRange, so many terminals share one buffer object and no
+/// glBufferData is issued per frame.
+/// The ring is split into segments. Leaving a segment fences the GPU work so
+/// far, and a segment is written again only after the fence placed one
+/// segment later has signaled. A range must be drawn before the next segment
+/// is filled. Live tells whether a range may still be drawn, so uniforms that
+/// did not change are not pushed again.
+class UniformRing {
+public:
+  static constexpr uint32_t SEGMENTS = 4;
+
+private:
+  uint32_t buffer_;
+  uint8_t *mapped_;
+  uint32_t segment_size_;
+  uint32_t alignment_;
+  // the segment being filled and the next free byte
+  uint32_t segment_ = 0;
+  uint32_t head_ = 0;
+  // segments left so far
+  uint64_t generation_ = 0;
+  // fences_[i] guards segment i
+  __GLsync *fences_[SEGMENTS] = {};
+  uint32_t waits_ = 0;
+
+  UniformRing(uint32_t buffer, uint8_t *mapped, uint32_t segment_size,
+              uint32_t alignment);
+
+public:
+  ~UniformRing();
+  UniformRing(const UniformRing &) = delete;
+  UniformRing &operator=(const UniformRing &) = delete;
+  // nullptr without GL_ARB_buffer_storage
+  static std::shared_ptr<UniformRing> Create(uint32_t size = 256 * 1024);
+  // an empty range if size exceeds a segment
+  UniformRange Push(const void *data, uint32_t size);
+  template <typename T> UniformRange Push(const T &t) {
+    return Push(&t, sizeof(T));
+  }
+  // the range is in the segment being filled or the one before it
+  bool Live(const UniformRange &range) const {
+    return range.size && range.buffer == buffer_ &&
+           generation_ - range.generation <= 1;
+  }
+  // glBindBufferRange to GL_UNIFORM_BUFFER
+  void Bind(uint32_t binding, const UniformRange &range);
+  uint32_t Handle() const { return buffer_; }
+  // times Push waited for the GPU
+  uint32_t Waits() const { return waits_; }
+
+private:
+  void Advance();
+};
+
+} // namespace glo
@@ -18,6 +18,8 @@ struct VertexLayout {
   uint32_t item_count;
   uint32_t stride;
   uint32_t byte_offset;
+  // 1 advances per instance. 0 per vertex
+  uint32_t divisor = 0;
 };
 
 class VAO {
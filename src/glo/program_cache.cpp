@@ -0,0 +1,192 @@
+#include "glo/program_cache.h"
+#include "glo/shader.h"
+#include <GL/glew.h>
+#include <fstream>
+#include <plog/Log.h>
+#include <string.h>
+#include <vector>
+
+namespace glo {
+
+// file: MAGIC, key, driver size, driver, format, binary size, binary
+static const char MAGIC[8] = {'G', 'L', 'O', 'P', 'R', 'O', 'G', '1'};
+
+static std::shared_ptr<ProgramCache> g_current;
+
+// FNV-1a
+static uint64_t Hash(uint64_t hash, const void *data, size_t size) {
+  auto p = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ p[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static uint64_t HashString(uint64_t hash, const char *s) {
+  // separate null from empty
+  uint8_t present = s != nullptr;
+  hash = Hash(hash, &present, 1);
+  return s ? Hash(hash, s, strlen(s) + 1) : hash;
+}
+
+static uint64_t HashConstants(uint64_t hash, uint8_t stage,
+                              std::span<const SpecializationConstant> c) {
+  // nothing for none. keys of unspecialized programs stay the same
+  if (c.empty()) {
+    return hash;
+  }
+  hash = Hash(hash, &stage, 1);
+  uint32_t count = static_cast<uint32_t>(c.size());
+  hash = Hash(hash, &count, sizeof(count));
+  return Hash(hash, c.data(), c.size_bytes());
+}
+
+static std::string GlString(GLenum name) {
+  auto s = reinterpret_cast<const char *>(glGetString(name));
+  return s ? s : "";
+}
+
+ProgramCache::ProgramCache(const std::filesystem::path &dir,
+                           const std::string &driver)
+    : dir_(dir), driver_(driver) {}
+
+ProgramCache::~ProgramCache() {}
+
+std::shared_ptr<ProgramCache>
+ProgramCache::Create(const std::filesystem::path &dir) {
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  if (formats == 0) {
+    PLOG_WARNING << "no program binary format";
+    return nullptr;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    PLOG_ERROR << dir << ": " << ec.message();
+    return nullptr;
+  }
+  auto driver = GlString(GL_VENDOR) + "\n" + GlString(GL_RENDERER) + "\n" +
+                GlString(GL_VERSION);
+  return std::shared_ptr<ProgramCache>(new ProgramCache(dir, driver));
+}
+
+void ProgramCache::SetCurrent(const std::shared_ptr<ProgramCache> &cache) {
+  g_current = cache;
+}
+
+ProgramCache *ProgramCache::Current() { return g_current.get(); }
+
+uint64_t ProgramCache::Key(const ShaderSources &src) const {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  hash = HashString(hash, src.vs);
+  hash = HashString(hash, src.fs);
+  hash = HashString(hash, src.gs);
+  uint8_t spirv = src.use_spirv;
+  hash = Hash(hash, &spirv, 1);
+  hash = HashConstants(hash, 0, src.vs_constants);
+  hash = HashConstants(hash, 1, src.fs_constants);
+  return HashConstants(hash, 2, src.gs_constants);
+}
+
+std::filesystem::path ProgramCache::Path(uint64_t key) const {
+  // the driver is in the name too. drivers do not overwrite each other
+  auto driver = Hash(0xcbf29ce484222325ull, driver_.data(), driver_.size());
+  char name[64];
+  snprintf(name, sizeof(name), "%016llx_%08x.bin",
+           static_cast<unsigned long long>(key),
+           static_cast<uint32_t>(driver));
+  return dir_ / name;
+}
+
+bool ProgramCache::Load(uint32_t program, uint64_t key) {
+  std::ifstream is(Path(key), std::ios::binary);
+  if (!is) {
+    ++stats_.misses;
+    return false;
+  }
+  char magic[sizeof(MAGIC)];
+  uint64_t file_key;
+  uint32_t driver_size;
+  is.read(magic, sizeof(magic));
+  is.read(reinterpret_cast<char *>(&file_key), sizeof(file_key));
+  is.read(reinterpret_cast<char *>(&driver_size), sizeof(driver_size));
+  if (!is || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || file_key != key ||
+      driver_size != driver_.size()) {
+    ++stats_.misses;
+    return false;
+  }
+  std::string driver(driver_size, '\0');
+  is.read(driver.data(), driver.size());
+  uint32_t format;
+  uint32_t size;
+  is.read(reinterpret_cast<char *>(&format), sizeof(format));
+  is.read(reinterpret_cast<char *>(&size), sizeof(size));
+  std::error_code ec;
+  auto file_size = std::filesystem::file_size(Path(key), ec);
+  if (!is || driver != driver_ || ec ||
+      static_cast<uint64_t>(is.tellg()) + size != file_size) {
+    ++stats_.misses;
+    return false;
+  }
+  std::vector<char> binary(size);
+  is.read(binary.data(), binary.size());
+  if (!is) {
+    ++stats_.misses;
+    return false;
+  }
+
+  glProgramBinary(program, format, binary.data(), size);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    // e.g. a driver update that kept the version string
+    ++stats_.rejected;
+    return false;
+  }
+  ++stats_.hits;
+  return true;
+}
+
+void ProgramCache::Store(uint32_t program, uint64_t key) {
+  GLint size = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0) {
+    return;
+  }
+  std::vector<char> binary(size);
+  GLenum format = 0;
+  glGetProgramBinary(program, size, &size, &format, binary.data());
+
+  // write and rename. a reader never sees a partial file
+  auto path = Path(key);
+  auto tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream os(tmp, std::ios::binary);
+    uint32_t driver_size = static_cast<uint32_t>(driver_.size());
+    uint32_t format32 = format;
+    uint32_t size32 = static_cast<uint32_t>(size);
+    os.write(MAGIC, sizeof(MAGIC));
+    os.write(reinterpret_cast<const char *>(&key), sizeof(key));
+    os.write(reinterpret_cast<const char *>(&driver_size),
+             sizeof(driver_size));
+    os.write(driver_.data(), driver_.size());
+    os.write(reinterpret_cast<const char *>(&format32), sizeof(format32));
+    os.write(reinterpret_cast<const char *>(&size32), sizeof(size32));
+    os.write(binary.data(), size);
+    if (!os) {
+      PLOG_WARNING << tmp << ": write failed";
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    PLOG_WARNING << path << ": " << ec.message();
+    return;
+  }
+  ++stats_.stores;
+}
+
+} // namespace glo
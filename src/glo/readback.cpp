@@ -0,0 +1,91 @@
+#include "glo/readback.h"
+#include "glo/state_cache.h"
+#include <GL/glew.h>
+#include <plog/Log.h>
+#include <string.h>
+
+namespace glo {
+
+PixelReader::PixelReader(size_t depth) : slots_(depth) {
+  for (auto &slot : slots_) {
+    glGenBuffers(1, &slot.pbo);
+  }
+}
+
+PixelReader::~PixelReader() {
+  for (auto &slot : slots_) {
+    if (slot.fence) {
+      glDeleteSync(slot.fence);
+    }
+    StateCache::Current().DeleteBuffer(slot.pbo);
+  }
+}
+
+std::shared_ptr<PixelReader> PixelReader::Create(size_t depth) {
+  if (depth == 0) {
+    return nullptr;
+  }
+  return std::shared_ptr<PixelReader>(new PixelReader(depth));
+}
+
+bool PixelReader::Read(int x, int y, int width, int height) {
+  if (pending_ == slots_.size()) {
+    PLOG_WARNING << "all pixel buffers are in flight";
+    return false;
+  }
+  auto &slot = slots_[(head_ + pending_) % slots_.size()];
+  auto size = static_cast<uint32_t>(width * height * 4);
+  StateCache::Current().BindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  if (size > slot.capacity) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    slot.capacity = size;
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // to the bound pbo. returns without waiting for the GPU
+  glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  StateCache::Current().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.width = width;
+  slot.height = height;
+  ++pending_;
+  return true;
+}
+
+bool PixelReader::TryGet(std::vector<uint8_t> &rgba, int *width, int *height,
+                         bool wait) {
+  if (!pending_) {
+    return false;
+  }
+  auto &slot = slots_[head_];
+  auto status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                 wait ? GL_TIMEOUT_IGNORED : 0);
+  if (status == GL_TIMEOUT_EXPIRED) {
+    return false;
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+  head_ = (head_ + 1) % slots_.size();
+  --pending_;
+  if (status == GL_WAIT_FAILED) {
+    PLOG_ERROR << "glClientWaitSync";
+    return false;
+  }
+
+  auto size = static_cast<size_t>(slot.width) * slot.height * 4;
+  StateCache::Current().BindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  auto p = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+  if (!p) {
+    StateCache::Current().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    PLOG_ERROR << "glMapBufferRange";
+    return false;
+  }
+  rgba.resize(size);
+  memcpy(rgba.data(), p, size);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  StateCache::Current().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  *width = slot.width;
+  *height = slot.height;
+  return true;
+}
+
+} // namespace glo
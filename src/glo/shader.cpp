@@ -1,7 +1,10 @@
 #include "glo/shader.h"
+#include "glo/program_cache.h"
+#include "glo/state_cache.h"
 #include "spirv_util.h"
 #include <GL/glew.h>
 #include <plog/Log.h>
+#include <vector>
 
 namespace glo {
 
@@ -19,45 +22,65 @@ std::shared_ptr<ShaderCompile> ShaderCompile::FragmentShader() {
 std::shared_ptr<ShaderCompile> ShaderCompile::GeometryShader() {
   return std::shared_ptr<ShaderCompile>(new ShaderCompile(GL_GEOMETRY_SHADER));
 }
-bool ShaderCompile::Compile(const char *src, bool use_spirv) {
+
+static std::optional<SpirvStage> ToSpirvStage(int shader_type) {
+  switch (shader_type) {
+  case GL_VERTEX_SHADER:
+    return SPIRV_STAGE_VS;
+  case GL_FRAGMENT_SHADER:
+    return SPIRV_STAGE_FS;
+  case GL_GEOMETRY_SHADER:
+    return SPIRV_STAGE_GS;
+  default:
+    return {};
+  }
+}
+
+bool ShaderCompile::Compile(
+    const char *src, bool use_spirv,
+    std::span<const SpecializationConstant> constants) {
   if (use_spirv) {
-    SPIRV_Initialize();
-    SpirvCompiler *compiler = nullptr;
-    switch (shader_type_) {
-    case GL_VERTEX_SHADER:
-      compiler = SPIRV_COMPILER_Create_VS();
-      break;
-
-    case GL_FRAGMENT_SHADER:
-      compiler = SPIRV_COMPILER_Create_FS();
-      break;
-
-    case GL_GEOMETRY_SHADER:
-      compiler = SPIRV_COMPILER_Create_GS();
-      break;
-
-    default:
+    auto stage = ToSpirvStage(shader_type_);
+    if (!stage) {
       PLOG_ERROR << "unknown shader: " << shader_type_;
       return false;
     }
-
+    // memoized by spirv_util
     unsigned int size = 0;
-    auto spirv = SPIRV_COMPILER_Compile(compiler, src, &size);
-    if (!size) {
-      PLOG_ERROR << SPIRV_COMPILER_GetError(compiler) << "\n" << src;
-      SPIRV_COMPILER_Destroy(compiler);
+    auto spirv = SPIRV_Compile(*stage, src, &size);
+    if (!spirv) {
+      PLOG_ERROR << SPIRV_GetLastError() << "\n" << src;
       return false;
     }
+    return LoadSpirv(spirv, size, constants);
+  }
 
-    glShaderBinary(1, &shader_, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, spirv,
-                   size * sizeof(unsigned int));
-    glSpecializeShaderARB(shader_, "main", 0, nullptr, nullptr);
-    SPIRV_COMPILER_Destroy(compiler);
-    SPIRV_Finalize();
-  } else {
-    glShaderSource(shader_, 1, &src, nullptr);
+  if (!constants.empty()) {
+    PLOG_ERROR << "specialization constants need SPIR-V";
+    return false;
   }
+  glShaderSource(shader_, 1, &src, nullptr);
+  return CompileStatus();
+}
 
+bool ShaderCompile::LoadSpirv(
+    const unsigned int *spirv, unsigned int size,
+    std::span<const SpecializationConstant> constants) {
+  glShaderBinary(1, &shader_, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, spirv,
+                 size * sizeof(unsigned int));
+  std::vector<GLuint> ids;
+  std::vector<GLuint> values;
+  for (auto &constant : constants) {
+    ids.push_back(constant.id);
+    values.push_back(constant.value);
+  }
+  // the driver folds the constants. branches on them are gone
+  glSpecializeShaderARB(shader_, "main", static_cast<GLuint>(ids.size()),
+                        ids.data(), values.data());
+  return CompileStatus();
+}
+
+bool ShaderCompile::CompileStatus() {
   glCompileShader(shader_);
   GLint isCompiled = 0;
   glGetShaderiv(shader_, GL_COMPILE_STATUS, &isCompiled);
@@ -84,46 +107,122 @@ ShaderProgram::ShaderProgram() {
 
 ShaderProgram::~ShaderProgram() {
   PLOG_INFO << "program: " << program_;
-  glDeleteProgram(program_);
+  StateCache::Current().DeleteProgram(program_);
 }
 
 std::shared_ptr<ShaderProgram> ShaderProgram::Create(const ShaderSources &src) {
 
+  // skip compile and link
+  auto cache = ProgramCache::Current();
+  uint64_t key = 0;
+  if (cache) {
+    key = cache->Key(src);
+    auto ptr = std::shared_ptr<ShaderProgram>(new ShaderProgram);
+    if (cache->Load(ptr->program_, key)) {
+      return ptr;
+    }
+  }
+
   // compile
   Shaders shaders{};
-  auto vs = ShaderCompile::VertexShader();
-  if (src.vs) {
-    if (vs->Compile(src.vs, src.use_spirv)) {
-      shaders.vs = vs->shader_;
-    } else {
+  if (src.use_spirv) {
+    if (!CompileSpirv(src, &shaders)) {
       return nullptr;
     }
-  }
-  auto fs = ShaderCompile::FragmentShader();
-  if (src.fs) {
-    if (fs->Compile(src.fs, src.use_spirv)) {
-      shaders.fs = fs->shader_;
-    } else {
+  } else {
+    if (!src.vs_constants.empty() || !src.fs_constants.empty() ||
+        !src.gs_constants.empty()) {
+      PLOG_ERROR << "specialization constants need SPIR-V";
       return nullptr;
     }
-  }
-  auto gs = glo::ShaderCompile::GeometryShader();
-  if (src.gs) {
-    if (gs->Compile(src.gs, src.use_spirv)) {
-      shaders.gs = gs->shader_;
-    } else {
-      return nullptr;
+    auto vs = ShaderCompile::VertexShader();
+    if (src.vs) {
+      if (vs->Compile(src.vs, false)) {
+        shaders.vs = vs->shader_;
+      } else {
+        return nullptr;
+      }
+    }
+    auto fs = ShaderCompile::FragmentShader();
+    if (src.fs) {
+      if (fs->Compile(src.fs, false)) {
+        shaders.fs = fs->shader_;
+      } else {
+        return nullptr;
+      }
+    }
+    auto gs = glo::ShaderCompile::GeometryShader();
+    if (src.gs) {
+      if (gs->Compile(src.gs, false)) {
+        shaders.gs = gs->shader_;
+      } else {
+        return nullptr;
+      }
     }
   }
 
   // link
   auto ptr = std::shared_ptr<ShaderProgram>(new ShaderProgram);
+  if (cache) {
+    glProgramParameteri(ptr->program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+  }
   if (!ptr->Link(shaders)) {
     return nullptr;
   }
+  if (cache) {
+    cache->Store(ptr->program_, key);
+  }
 
   return ptr;
 }
+
+// glslang runs for the stages concurrently. GL calls stay on this thread
+bool ShaderProgram::CompileSpirv(const ShaderSources &src, Shaders *shaders) {
+  struct Stage {
+    std::shared_ptr<ShaderCompile> compile;
+    uint32_t *shader;
+    std::span<const SpecializationConstant> constants;
+  };
+  Stage targets[3];
+  SpirvStage stages[3];
+  const char *srcs[3];
+  unsigned int count = 0;
+  auto add = [&](const std::shared_ptr<ShaderCompile> &compile,
+                 SpirvStage stage, const char *stage_src, uint32_t *shader,
+                 std::span<const SpecializationConstant> constants) {
+    if (stage_src) {
+      targets[count] = {compile, shader, constants};
+      stages[count] = stage;
+      srcs[count] = stage_src;
+      ++count;
+    }
+  };
+  add(ShaderCompile::VertexShader(), SPIRV_STAGE_VS, src.vs, &shaders->vs,
+      src.vs_constants);
+  add(ShaderCompile::FragmentShader(), SPIRV_STAGE_FS, src.fs, &shaders->fs,
+      src.fs_constants);
+  add(ShaderCompile::GeometryShader(), SPIRV_STAGE_GS, src.gs, &shaders->gs,
+      src.gs_constants);
+
+  const unsigned int *words[3] = {};
+  unsigned int sizes[3] = {};
+  SPIRV_CompileStages(count, stages, srcs, words, sizes);
+
+  for (unsigned int i = 0; i < count; ++i) {
+    if (!words[i]) {
+      PLOG_ERROR << SPIRV_GetLastError() << "\n" << srcs[i];
+      return false;
+    }
+    // one SPIR-V module, specialized per program
+    if (!targets[i].compile->LoadSpirv(words[i], sizes[i],
+                                       targets[i].constants)) {
+      return false;
+    }
+    *targets[i].shader = targets[i].compile->shader_;
+  }
+  return true;
+}
 bool ShaderProgram::Link(Shaders shaders) {
   if (shaders.vs)
     glAttachShader(program_, shaders.vs);
@@ -150,8 +249,10 @@ bool ShaderProgram::Link(Shaders shaders) {
   }
   return true;
 }
-void ShaderProgram::Bind() { glUseProgram(program_); }
-void ShaderProgram::Unbind() { glUseProgram(0); }
+void ShaderProgram::Bind() {
+  StateCache::Current().UseProgram(program_);
+}
+void ShaderProgram::Unbind() { StateCache::Current().Release(); }
 
 std::optional<uint32_t> ShaderProgram::AttributeLocation(const char *name) {
   auto location = glGetAttribLocation(program_, name);
@@ -166,8 +267,11 @@ void ShaderProgram::SetUniformMatrix(const char *name, const float m[16]) {
   glUniformMatrix4fv(location, 1, GL_FALSE, m);
 }
 
+void SetSpirvCacheDir(const char *dir) { SPIRV_SetCacheDir(dir); }
+
 void ShaderProgram::SetUBO(int binding_point, uint32_t ubo) {
-  glBindBufferBase(GL_UNIFORM_BUFFER, binding_point, ubo);
+  StateCache::Current().BindBufferBase(GL_UNIFORM_BUFFER, binding_point,
+                                       ubo);
 }
 
 } // namespace glo
\ No newline at end of file
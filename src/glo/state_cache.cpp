@@ -0,0 +1,175 @@
+#include "glo/state_cache.h"
+#include <GL/glew.h>
+
+namespace glo {
+
+static uint64_t Pair(uint32_t hi, uint32_t lo) {
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+// a GL context is current on one thread. plain pointers, nothing to destroy
+// at thread exit before the statics that still free GL objects
+static thread_local StateCache *t_current = nullptr;
+static thread_local StateCache *t_uncached = nullptr;
+
+std::shared_ptr<StateCache> StateCache::Create() {
+  return std::shared_ptr<StateCache>(new StateCache);
+}
+
+void StateCache::SetCurrent(StateCache *cache) { t_current = cache; }
+
+StateCache &StateCache::Current() {
+  if (t_current) {
+    return *t_current;
+  }
+  if (!t_uncached) {
+    // never freed
+    t_uncached = new StateCache;
+  }
+  t_uncached->Invalidate();
+  return *t_uncached;
+}
+
+void StateCache::BindBuffer(uint32_t target, uint32_t buffer) {
+  if (Set(buffers_, target, buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void StateCache::BindBufferBase(uint32_t target, uint32_t index,
+                                uint32_t buffer) {
+  if (Set(indexed_buffers_, Pair(target, index), IndexedBuffer{buffer})) {
+    glBindBufferBase(target, index, buffer);
+    buffers_[target] = buffer;
+  }
+}
+
+void StateCache::BindBufferRange(uint32_t target, uint32_t index,
+                                 uint32_t buffer, uint64_t offset,
+                                 uint64_t size) {
+  if (Set(indexed_buffers_, Pair(target, index),
+          IndexedBuffer{buffer, offset, size})) {
+    glBindBufferRange(target, index, buffer, static_cast<GLintptr>(offset),
+                      static_cast<GLsizeiptr>(size));
+    buffers_[target] = buffer;
+  }
+}
+
+void StateCache::BindVertexArray(uint32_t vertex_array) {
+  if (Set(vertex_array_, vertex_array)) {
+    glBindVertexArray(vertex_array);
+  }
+}
+
+void StateCache::ActiveTexture(uint32_t unit) {
+  if (Set(active_texture_, unit)) {
+    glActiveTexture(unit);
+  }
+}
+
+void StateCache::BindTexture(uint32_t target, uint32_t texture) {
+  // GL starts with unit 0
+  auto unit = active_texture_.value_or(GL_TEXTURE0);
+  if (!active_texture_) {
+    // the unit is unknown after Invalidate. make sure
+    ActiveTexture(unit);
+  }
+  if (Set(textures_, Pair(unit, target), texture)) {
+    glBindTexture(target, texture);
+  }
+}
+
+void StateCache::BindFramebuffer(uint32_t framebuffer) {
+  if (Set(framebuffer_, framebuffer)) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  }
+}
+
+void StateCache::UseProgram(uint32_t program) {
+  if (Set(program_, program)) {
+    glUseProgram(program);
+  }
+}
+
+void StateCache::Enable(uint32_t cap) {
+  if (Set(caps_, cap, true)) {
+    glEnable(cap);
+  }
+}
+
+void StateCache::Disable(uint32_t cap) {
+  if (Set(caps_, cap, false)) {
+    glDisable(cap);
+  }
+}
+
+void StateCache::BlendFunc(uint32_t src, uint32_t dst) {
+  if (Set(blend_func_, std::make_pair(src, dst))) {
+    glBlendFunc(src, dst);
+  }
+}
+
+void StateCache::DeleteBuffer(uint32_t buffer) {
+  glDeleteBuffers(1, &buffer);
+  for (auto &[target, bound] : buffers_) {
+    if (bound == buffer) {
+      bound = 0;
+    }
+  }
+  for (auto &[target, bound] : indexed_buffers_) {
+    if (bound.buffer == buffer) {
+      bound = {};
+    }
+  }
+}
+
+void StateCache::DeleteVertexArray(uint32_t vertex_array) {
+  glDeleteVertexArrays(1, &vertex_array);
+  if (vertex_array_ == vertex_array) {
+    vertex_array_ = 0;
+  }
+}
+
+void StateCache::DeleteTexture(uint32_t texture) {
+  glDeleteTextures(1, &texture);
+  for (auto &[target, bound] : textures_) {
+    if (bound == texture) {
+      bound = 0;
+    }
+  }
+}
+
+void StateCache::DeleteFramebuffer(uint32_t framebuffer) {
+  glDeleteFramebuffers(1, &framebuffer);
+  if (framebuffer_ == framebuffer) {
+    framebuffer_ = 0;
+  }
+}
+
+void StateCache::DeleteProgram(uint32_t program) {
+  glDeleteProgram(program);
+  if (program_ == program) {
+    // GL keeps a deleted program in use until another is used
+    program_.reset();
+  }
+}
+
+void StateCache::Invalidate() {
+  buffers_.clear();
+  indexed_buffers_.clear();
+  textures_.clear();
+  caps_.clear();
+  active_texture_.reset();
+  vertex_array_.reset();
+  program_.reset();
+  framebuffer_.reset();
+  blend_func_.reset();
+}
+
+void StateCache::EndFrame() {
+  last_frame_ = frame_;
+  frame_ = {};
+  ++frames_;
+}
+
+} // namespace glo
@@ -1,4 +1,5 @@
 #include "glo/texture.h"
+#include "glo/state_cache.h"
 #include <GL/glew.h>
 #include <memory>
 #include <plog/Log.h>
@@ -16,7 +17,7 @@ Texture::Texture(int width, int height, int pixel_type)
 
 Texture::~Texture() {
   // PLOG_DEBUG << handle_;
-  glDeleteTextures(1, &handle_);
+  StateCache::Current().DeleteTexture(handle_);
 }
 
 std::shared_ptr<Texture> Texture::Create(int width, int height, int pixel_type,
@@ -35,6 +36,21 @@ std::shared_ptr<Texture> Texture::Create(int width, int height, int pixel_type,
   return ptr;
 }
 
+int Texture::BytesPerPixel() const {
+  switch (pixel_type_) {
+  case GL_RED:
+    return 1;
+  case GL_RG:
+    return 2;
+  case GL_RGB:
+    return 3;
+  case GL_RGBA:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
 void Texture::Update(int x, int y, int w, int h, const uint8_t *data) {
   Bind();
 
@@ -54,8 +70,10 @@ void Texture::Update(int x, int y, int w, int h, const uint8_t *data) {
   Unbind();
 }
 
-void Texture::Bind() { glBindTexture(GL_TEXTURE_2D, handle_); }
+void Texture::Bind() {
+  StateCache::Current().BindTexture(GL_TEXTURE_2D, handle_);
+}
 
-void Texture::Unbind() { glBindTexture(GL_TEXTURE_2D, 0); }
+void Texture::Unbind() { StateCache::Current().Release(); }
 
 } // namespace glo
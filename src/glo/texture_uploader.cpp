@@ -0,0 +1,120 @@
+#include "glo/texture_uploader.h"
+#include "glo/state_cache.h"
+#include "glo/texture.h"
+#include <GL/glew.h>
+#include <plog/Log.h>
+#include <string.h>
+
+namespace glo {
+
+TextureUploader::TextureUploader(size_t depth) : slots_(depth) {
+  for (auto &slot : slots_) {
+    glGenBuffers(1, &slot.pbo);
+  }
+}
+
+TextureUploader::~TextureUploader() {
+  for (auto &slot : slots_) {
+    if (slot.fence) {
+      glDeleteSync(slot.fence);
+    }
+    StateCache::Current().DeleteBuffer(slot.pbo);
+  }
+}
+
+std::shared_ptr<TextureUploader> TextureUploader::Create(size_t depth) {
+  if (depth == 0) {
+    return nullptr;
+  }
+  return std::shared_ptr<TextureUploader>(new TextureUploader(depth));
+}
+
+bool TextureUploader::Upload(Texture &texture, int x, int y, int w, int h,
+                             const uint8_t *data) {
+  auto bpp = texture.BytesPerPixel();
+  if (bpp == 0) {
+    PLOG_ERROR << "texture uploader: unknown format " << texture.PixelType();
+    return false;
+  }
+  auto &slot = slots_[next_];
+  if (slot.fence) {
+    // never waits
+    auto status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return false;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+  }
+
+  auto size = static_cast<uint32_t>(w * h * bpp);
+  auto &state = StateCache::Current();
+  state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+  if (size > slot.capacity) {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    slot.capacity = size;
+  }
+  // the fence has signaled. the GPU is done with the old contents
+  auto p = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                                GL_MAP_UNSYNCHRONIZED_BIT);
+  if (!p) {
+    state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    PLOG_ERROR << "glMapBufferRange";
+    return false;
+  }
+  memcpy(p, data, size);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+  // from the bound pbo. returns before the copy
+  texture.Bind();
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, texture.PixelType(),
+                  GL_UNSIGNED_BYTE, nullptr);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  texture.Unbind();
+  // other uploads read client memory again
+  state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  next_ = (next_ + 1) % slots_.size();
+  return true;
+}
+
+void TextureUploader::Post(const std::shared_ptr<Texture> &texture, int x,
+                           int y, int w, int h, std::vector<uint8_t> pixels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  posted_.push_back({texture, x, y, w, h, std::move(pixels)});
+}
+
+size_t TextureUploader::Flush() {
+  std::vector<Posted> posted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(posted, posted_);
+  }
+  size_t i = 0;
+  size_t uploaded = 0;
+  for (; i < posted.size(); ++i) {
+    auto &item = posted[i];
+    auto texture = item.texture.lock();
+    if (!texture) {
+      continue;
+    }
+    if (!Upload(*texture, item.x, item.y, item.w, item.h,
+                item.pixels.data())) {
+      break;
+    }
+    ++uploaded;
+  }
+  if (i < posted.size()) {
+    // keep the order. before anything posted meanwhile
+    std::lock_guard<std::mutex> lock(mutex_);
+    posted_.insert(posted_.begin(),
+                   std::make_move_iterator(posted.begin() + i),
+                   std::make_move_iterator(posted.end()));
+  }
+  return uploaded;
+}
+
+} // namespace glo
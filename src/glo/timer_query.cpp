@@ -0,0 +1,61 @@
+#include "glo/timer_query.h"
+#include <GL/glew.h>
+
+namespace glo {
+
+TimerQuery::TimerQuery(size_t depth) : queries_(depth) {
+  glGenQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+}
+
+TimerQuery::~TimerQuery() {
+  glDeleteQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+}
+
+std::shared_ptr<TimerQuery> TimerQuery::Create(size_t depth) {
+  if (depth == 0) {
+    return nullptr;
+  }
+  return std::shared_ptr<TimerQuery>(new TimerQuery(depth));
+}
+
+bool TimerQuery::Begin() {
+  if (active_) {
+    return false;
+  }
+  if (pending_ == queries_.size()) {
+    ++dropped_;
+    return false;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, queries_[(head_ + pending_) % queries_.size()]);
+  active_ = true;
+  return true;
+}
+
+void TimerQuery::End() {
+  if (!active_) {
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  active_ = false;
+  ++pending_;
+}
+
+bool TimerQuery::TryGet(std::chrono::nanoseconds *elapsed) {
+  if (!pending_) {
+    return false;
+  }
+  auto query = queries_[head_];
+  GLint available = 0;
+  glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    return false;
+  }
+  GLuint64 ns = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+  *elapsed = std::chrono::nanoseconds(ns);
+  head_ = (head_ + 1) % queries_.size();
+  --pending_;
+  return true;
+}
+
+} // namespace glo
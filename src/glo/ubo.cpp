@@ -1,20 +1,28 @@
 #include "glo/ubo.h"
+#include "glo/state_cache.h"
 #include <GL/glew.h>
 
 namespace glo {
 
 UBO::UBO() { glCreateBuffers(1, &ubo_); }
-UBO::~UBO() { glDeleteBuffers(1, &ubo_); }
+UBO::~UBO() { StateCache::Current().DeleteBuffer(ubo_); }
 std::shared_ptr<UBO> UBO::Create() { return std::shared_ptr<UBO>(new UBO); }
-void UBO::Bind() { glBindBuffer(GL_UNIFORM_BUFFER, ubo_); }
-void UBO::Unbind() { glBindBuffer(GL_UNIFORM_BUFFER, 0); }
+void UBO::Bind() {
+  StateCache::Current().BindBuffer(GL_UNIFORM_BUFFER, ubo_);
+}
+void UBO::Unbind() { StateCache::Current().Release(); }
 void UBO::Upload(const void *data, uint32_t size) {
   Bind();
   glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
   Unbind();
 }
+void UBO::SubUpload(uint32_t offset, const void *data, uint32_t size) {
+  Bind();
+  glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+  Unbind();
+}
 void UBO::BindBase(int binding) {
-  glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo_);
+  StateCache::Current().BindBufferBase(GL_UNIFORM_BUFFER, binding, ubo_);
 }
 
 } // namespace glo
@@ -0,0 +1,107 @@
+#include "glo/uniform_ring.h"
+#include "glo/state_cache.h"
+#include <GL/glew.h>
+#include <plog/Log.h>
+#include <string.h>
+
+namespace glo {
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+UniformRing::UniformRing(uint32_t buffer, uint8_t *mapped,
+                         uint32_t segment_size, uint32_t alignment)
+    : buffer_(buffer), mapped_(mapped), segment_size_(segment_size),
+      alignment_(alignment) {}
+
+UniformRing::~UniformRing() {
+  for (auto fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  // unmapped with the buffer
+  StateCache::Current().DeleteBuffer(buffer_);
+}
+
+std::shared_ptr<UniformRing> UniformRing::Create(uint32_t size) {
+  if (!(GLEW_ARB_buffer_storage)) {
+    PLOG_WARNING << "no GL_ARB_buffer_storage";
+    return nullptr;
+  }
+  GLint alignment = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  auto segment_size =
+      size / SEGMENTS / static_cast<uint32_t>(alignment) * alignment;
+  if (segment_size == 0) {
+    PLOG_ERROR << "uniform ring is too small: " << size;
+    return nullptr;
+  }
+
+  GLuint buffer;
+  glCreateBuffers(1, &buffer);
+  auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glNamedBufferStorage(buffer, segment_size * SEGMENTS, nullptr, flags);
+  auto mapped = static_cast<uint8_t *>(
+      glMapNamedBufferRange(buffer, 0, segment_size * SEGMENTS, flags));
+  if (!mapped) {
+    PLOG_ERROR << "glMapNamedBufferRange";
+    StateCache::Current().DeleteBuffer(buffer);
+    return nullptr;
+  }
+  return std::shared_ptr<UniformRing>(
+      new UniformRing(buffer, mapped, segment_size, alignment));
+}
+
+UniformRange UniformRing::Push(const void *data, uint32_t size) {
+  if (size == 0 || size > segment_size_) {
+    PLOG_ERROR << "uniform ring: " << size << " bytes do not fit a segment";
+    return {};
+  }
+  // a range does not cross segments
+  auto offset = AlignUp(head_, alignment_);
+  if (offset + size > (segment_ + 1) * segment_size_) {
+    Advance();
+    offset = segment_ * segment_size_;
+  }
+  // coherent. visible to the GPU without a flush
+  memcpy(mapped_ + offset, data, size);
+  head_ = offset + size;
+  return {buffer_, offset, size, generation_};
+}
+
+void UniformRing::Bind(uint32_t binding, const UniformRange &range) {
+  StateCache::Current().BindBufferRange(GL_UNIFORM_BUFFER, binding,
+                                        range.buffer, range.offset,
+                                        range.size);
+}
+
+void UniformRing::Advance() {
+  // the draws that read the previous segment were issued by now
+  auto previous = (segment_ + SEGMENTS - 1) % SEGMENTS;
+  if (fences_[previous]) {
+    glDeleteSync(fences_[previous]);
+  }
+  fences_[previous] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  segment_ = (segment_ + 1) % SEGMENTS;
+  ++generation_;
+  head_ = segment_ * segment_size_;
+  if (auto fence = fences_[segment_]) {
+    // blocks only if the GPU is a whole ring behind
+    auto status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      ++waits_;
+      status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                1000 * 1000 * 1000);
+    }
+    if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+      PLOG_WARNING << "uniform ring: fence wait failed";
+    }
+    glDeleteSync(fence);
+    fences_[segment_] = nullptr;
+  }
+}
+
+} // namespace glo
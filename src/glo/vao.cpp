@@ -1,5 +1,6 @@
 #include "glo/vao.h"
 #include "glo/scoped_binder.h"
+#include "glo/state_cache.h"
 #include "plog/Log.h"
 #include <gl/glew.h>
 
@@ -11,7 +12,7 @@ namespace glo {
 VAO::VAO(const std::shared_ptr<::glo::VBO> &vbo) : vbo_(vbo) {
   glGenVertexArrays(1, &vao_);
 }
-VAO::~VAO() { glDeleteVertexArrays(1, &vao_); }
+VAO::~VAO() { StateCache::Current().DeleteVertexArray(vao_); }
 std::shared_ptr<VAO> VAO::Create(const std::shared_ptr<::glo::VBO> vbo,
                                  std::span<VertexLayout> layouts) {
   auto ptr = std::shared_ptr<VAO>(new VAO(vbo));
@@ -37,12 +38,15 @@ std::shared_ptr<VAO> VAO::Create(const std::shared_ptr<::glo::VBO> vbo,
       PLOG_FATAL << "unknown gl_type";
       return nullptr;
     }
+    if (layout.divisor) {
+      glVertexAttribDivisor(layout.attribute.location, layout.divisor);
+    }
   }
 
   return ptr;
 }
-void VAO::Bind() { glBindVertexArray(vao_); }
-void VAO::Unbind() { glBindVertexArray(0); }
+void VAO::Bind() { StateCache::Current().BindVertexArray(vao_); }
+void VAO::Unbind() { StateCache::Current().Release(); }
 void VAO::Draw(int topology, int offset, int count) {
   Bind();
   glDrawArrays(topology, offset, count);
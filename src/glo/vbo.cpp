@@ -1,4 +1,5 @@
 #include "glo/vbo.h"
+#include "glo/state_cache.h"
 #include <GL/glew.h>
 #include <assert.h>
 #include <stdint.h>
@@ -9,10 +10,12 @@ namespace glo {
 // VBO
 //
 VBO::VBO() { glGenBuffers(1, &vbo_); }
-VBO::~VBO() { glDeleteBuffers(1, &vbo_); }
+VBO::~VBO() { StateCache::Current().DeleteBuffer(vbo_); }
 std::shared_ptr<VBO> VBO::Create() { return std::shared_ptr<VBO>(new VBO); }
-void VBO::Bind() { glBindBuffer(GL_ARRAY_BUFFER, vbo_); }
-void VBO::Unbind() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
+void VBO::Bind() {
+  StateCache::Current().BindBuffer(GL_ARRAY_BUFFER, vbo_);
+}
+void VBO::Unbind() { StateCache::Current().Release(); }
 void VBO::SetData(uint32_t buffer_size, const void *data, bool is_dynamic) {
   // assert(buffer_size);
   Bind();
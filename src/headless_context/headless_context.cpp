@@ -0,0 +1,134 @@
+#include "headless_context.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <glo/fbo.h>
+#include <glo/state_cache.h>
+#include <plog/Log.h>
+#include <string.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static bool HasExtension(const char *extensions, const char *name) {
+  if (!extensions) {
+    return false;
+  }
+  auto len = strlen(name);
+  for (auto p = strstr(extensions, name); p; p = strstr(p + len, name)) {
+    if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || !p[len])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static EGLDisplay GetDisplay() {
+  auto client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (HasExtension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+    auto eglGetPlatformDisplayEXT =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (eglGetPlatformDisplayEXT) {
+      auto display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,
+                                              EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY) {
+        return display;
+      }
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+HeadlessContext::HeadlessContext() {}
+
+HeadlessContext::~HeadlessContext() {
+  if (fbo_pool_) {
+    MakeCurrent();
+    fbo_pool_->Clear();
+    glo::FboPool::SetDefault(nullptr);
+    glo::StateCache::SetCurrent(nullptr);
+  }
+  if (display_) {
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context_) {
+      eglDestroyContext(display_, context_);
+    }
+    eglTerminate(display_);
+  }
+}
+
+bool HeadlessContext::Create(int major, int minor) {
+  auto display = GetDisplay();
+  if (display == EGL_NO_DISPLAY) {
+    PLOG_ERROR << "eglGetDisplay";
+    return false;
+  }
+  EGLint egl_major, egl_minor;
+  if (!eglInitialize(display, &egl_major, &egl_minor)) {
+    PLOG_ERROR << "eglInitialize: " << eglGetError();
+    return false;
+  }
+  display_ = display;
+  PLOG_INFO << "EGL_VERSION: " << egl_major << "." << egl_minor;
+
+  if (!HasExtension(eglQueryString(display, EGL_EXTENSIONS),
+                    "EGL_KHR_surfaceless_context")) {
+    PLOG_ERROR << "EGL_KHR_surfaceless_context is not supported";
+    return false;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    PLOG_ERROR << "eglBindAPI: " << eglGetError();
+    return false;
+  }
+
+  EGLint config_attribs[] = {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, //
+      EGL_RED_SIZE,        8,              //
+      EGL_GREEN_SIZE,      8,              //
+      EGL_BLUE_SIZE,       8,              //
+      EGL_ALPHA_SIZE,      8,              //
+      EGL_NONE,
+  };
+  EGLConfig config;
+  EGLint config_count = 0;
+  if (!eglChooseConfig(display, config_attribs, &config, 1, &config_count) ||
+      config_count == 0) {
+    // surfaceless does not need a config
+    config = nullptr;
+  }
+
+  EGLint context_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION,
+      major,
+      EGL_CONTEXT_MINOR_VERSION,
+      minor,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK,
+      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE,
+  };
+  context_ = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+  if (context_ == EGL_NO_CONTEXT) {
+    PLOG_ERROR << "eglCreateContext: " << eglGetError();
+    context_ = nullptr;
+    return false;
+  }
+  fbo_pool_ = std::make_shared<glo::FboPool>();
+  gl_state_ = glo::StateCache::Create();
+  MakeCurrent();
+
+  glsl_version_ = "#version " + std::to_string(major * 100 + minor * 10);
+  PLOG_INFO << "GL_VERSION: " << glGetString(GL_VERSION);
+  PLOG_INFO << "GL_VENDOR: " << glGetString(GL_VENDOR);
+  PLOG_INFO << "GL_RENDERER: " << glGetString(GL_RENDERER);
+  return true;
+}
+
+void HeadlessContext::MakeCurrent() {
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_);
+  glo::FboPool::SetDefault(fbo_pool_);
+  // GL calls outside glo may have run on the context meanwhile
+  gl_state_->Invalidate();
+  glo::StateCache::SetCurrent(gl_state_.get());
+}
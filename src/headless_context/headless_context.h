@@ -0,0 +1,33 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace glo {
+class FboPool;
+class StateCache;
+}
+
+/// OpenGL context without a window.
+/// EGL on the surfaceless platform (Mesa llvmpipe works without a GPU or a
+/// display server). Render into a glo::Fbo.
+class HeadlessContext {
+  void *display_ = nullptr;
+  void *context_ = nullptr;
+  std::string glsl_version_;
+  // freed before the context
+  std::shared_ptr<glo::FboPool> fbo_pool_;
+  std::shared_ptr<glo::StateCache> gl_state_;
+
+public:
+  HeadlessContext();
+  ~HeadlessContext();
+  HeadlessContext(const HeadlessContext &) = delete;
+  HeadlessContext &operator=(const HeadlessContext &) = delete;
+  std::string_view glsl_version() const { return glsl_version_; }
+  // create a core profile context and make it current
+  bool Create(int major = 4, int minor = 5);
+  // also makes its FboPool the default and its glo::StateCache current.
+  // the cache is invalidated
+  void MakeCurrent();
+};
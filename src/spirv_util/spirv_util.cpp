@@ -2,8 +2,15 @@
 #include <glslang/Public/ResourceLimits.h>
 #include <glslang/Public/ShaderLang.h>
 #include <glslang/SPIRV/GlslangToSpv.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
-// #include <fstream>
 // #include <stdexcept>
 
 // static EShLanguage translateShaderStage(std::string_view filepath) {
@@ -52,8 +59,12 @@ struct SpirvCompiler {
   const char *get_error() { return shader_.getInfoLog(); }
 };
 
-SPIRV_UTIL_API void SPIRV_Initialize() { glslang::InitializeProcess(); }
-SPIRV_UTIL_API void SPIRV_Finalize() { glslang::FinalizeProcess(); }
+static std::once_flag g_initialize;
+SPIRV_UTIL_API void SPIRV_Initialize() {
+  std::call_once(g_initialize, []() { glslang::InitializeProcess(); });
+}
+// glslang is kept until the process exits. the memoized SPIR-V outlives it
+SPIRV_UTIL_API void SPIRV_Finalize() {}
 SPIRV_UTIL_API SpirvCompiler *SPIRV_COMPILER_Create_VS() {
   return new SpirvCompiler(EShLangVertex);
 }
@@ -74,6 +85,203 @@ SPIRV_COMPILER_Compile(SpirvCompiler *context, const char *src,
 SPIRV_UTIL_API const char *SPIRV_COMPILER_GetError(SpirvCompiler *context) {
   return context->get_error();
 }
+//
+// memoized
+//
+struct SpirvEntry {
+  SpirvStage stage;
+  std::string src;
+  std::vector<unsigned int> spirv;
+};
+
+static std::mutex g_mutex;
+// FNV-1a of stage and src
+static std::unordered_map<uint64_t, std::unique_ptr<SpirvEntry>> g_entries;
+// hash collisions. kept alive but not looked up
+static std::vector<std::unique_ptr<SpirvEntry>> g_collided;
+static std::filesystem::path g_cache_dir;
+static thread_local std::string g_error;
+
+static uint64_t hash_source(SpirvStage stage, const char *src) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  auto add = [&hash](uint8_t byte) {
+    hash = (hash ^ byte) * 0x100000001b3ull;
+  };
+  add(static_cast<uint8_t>(stage));
+  for (auto p = src; *p; ++p) {
+    add(static_cast<uint8_t>(*p));
+  }
+  return hash;
+}
+
+static EShLanguage to_language(SpirvStage stage) {
+  switch (stage) {
+  case SPIRV_STAGE_VS:
+    return EShLangVertex;
+  case SPIRV_STAGE_FS:
+    return EShLangFragment;
+  default:
+    return EShLangGeometry;
+  }
+}
+
+// file: MAGIC, stage, source size, source, words.
+// the whole source is compared. the file name is only its hash.
+// specialization constants are applied by glSpecializeShader, the words do
+// not depend on them. bump MAGIC when the compile options change
+static const char MAGIC[8] = {'G', 'L', 'O', 'S', 'P', 'V', '0', '2'};
+
+static bool read_file(const std::filesystem::path &path, SpirvEntry *entry) {
+  std::ifstream is(path, std::ios::binary);
+  if (!is) {
+    return false;
+  }
+  char magic[sizeof(MAGIC)];
+  uint32_t stage;
+  uint64_t src_size;
+  is.read(magic, sizeof(magic));
+  is.read(reinterpret_cast<char *>(&stage), sizeof(stage));
+  is.read(reinterpret_cast<char *>(&src_size), sizeof(src_size));
+  if (!is || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      stage != entry->stage || src_size != entry->src.size()) {
+    return false;
+  }
+  std::string src(src_size, '\0');
+  is.read(src.data(), src.size());
+  if (!is || src != entry->src) {
+    return false;
+  }
+  std::vector<unsigned int> spirv;
+  unsigned int word;
+  while (is.read(reinterpret_cast<char *>(&word), sizeof(word))) {
+    spirv.push_back(word);
+  }
+  if (spirv.empty()) {
+    return false;
+  }
+  entry->spirv = std::move(spirv);
+  return true;
+}
+
+static void write_file(const std::filesystem::path &path,
+                       const SpirvEntry &entry) {
+  auto tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream os(tmp, std::ios::binary);
+    uint32_t stage = entry.stage;
+    uint64_t src_size = entry.src.size();
+    os.write(MAGIC, sizeof(MAGIC));
+    os.write(reinterpret_cast<const char *>(&stage), sizeof(stage));
+    os.write(reinterpret_cast<const char *>(&src_size), sizeof(src_size));
+    os.write(entry.src.data(), entry.src.size());
+    os.write(reinterpret_cast<const char *>(entry.spirv.data()),
+             entry.spirv.size() * sizeof(unsigned int));
+    if (!os) {
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+}
+
+SPIRV_UTIL_API const unsigned int *
+SPIRV_Compile(SpirvStage stage, const char *src, unsigned int *out_size) {
+  SPIRV_Initialize();
+
+  auto hash = hash_source(stage, src);
+  std::filesystem::path path;
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto found = g_entries.find(hash);
+    if (found != g_entries.end() && found->second->stage == stage &&
+        found->second->src == src) {
+      *out_size = found->second->spirv.size();
+      return found->second->spirv.data();
+    }
+    if (!g_cache_dir.empty()) {
+      char name[32];
+      snprintf(name, sizeof(name), "%016llx.spv",
+               static_cast<unsigned long long>(hash));
+      path = g_cache_dir / name;
+    }
+  }
+
+  // outside the lock. stages of a program are compiled concurrently
+  auto entry = std::make_unique<SpirvEntry>();
+  entry->stage = stage;
+  entry->src = src;
+  if (path.empty() || !read_file(path, entry.get())) {
+    SpirvCompiler compiler(to_language(stage));
+    unsigned int size = 0;
+    auto words = compiler.compile(src, &size);
+    if (!words || !size) {
+      g_error = compiler.get_error();
+      *out_size = 0;
+      return nullptr;
+    }
+    entry->spirv.assign(words, words + size);
+    if (!path.empty()) {
+      write_file(path, *entry);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  auto &slot = g_entries[hash];
+  if (!slot) {
+    slot = std::move(entry);
+  } else if (slot->stage != stage || slot->src != src) {
+    g_collided.push_back(std::move(entry));
+    *out_size = g_collided.back()->spirv.size();
+    return g_collided.back()->spirv.data();
+  }
+  // the first one wins if the same source was compiled twice
+  *out_size = slot->spirv.size();
+  return slot->spirv.data();
+}
+
+SPIRV_UTIL_API void SPIRV_CompileStages(unsigned int count,
+                                        const SpirvStage *stages,
+                                        const char *const *srcs,
+                                        const unsigned int **out_words,
+                                        unsigned int *out_sizes) {
+  std::vector<std::future<std::string>> errors;
+  for (unsigned int i = 1; i < count; ++i) {
+    errors.push_back(std::async(std::launch::async, [=]() {
+      out_words[i] = SPIRV_Compile(stages[i], srcs[i], &out_sizes[i]);
+      return out_words[i] ? std::string() : g_error;
+    }));
+  }
+  // the first on this thread
+  std::string error;
+  if (count > 0) {
+    out_words[0] = SPIRV_Compile(stages[0], srcs[0], &out_sizes[0]);
+    if (!out_words[0]) {
+      error = g_error;
+    }
+  }
+  for (auto &f : errors) {
+    auto e = f.get();
+    if (error.empty()) {
+      error = e;
+    }
+  }
+  if (!error.empty()) {
+    g_error = error;
+  }
+}
+
+SPIRV_UTIL_API const char *SPIRV_GetLastError() { return g_error.c_str(); }
+
+SPIRV_UTIL_API void SPIRV_SetCacheDir(const char *dir) {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_cache_dir = dir ? dir : "";
+  if (!g_cache_dir.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(g_cache_dir, ec);
+  }
+}
+
 // struct SpirvLinker {
 //   glslang::TProgram program_;
 
@@ -20,6 +20,27 @@ SPIRV_COMPILER_Compile(SpirvCompiler *context, const char *src,
                        unsigned int *out_size);
 SPIRV_UTIL_API const char *SPIRV_COMPILER_GetError(SpirvCompiler *context);
 
+enum SpirvStage {
+  SPIRV_STAGE_VS,
+  SPIRV_STAGE_FS,
+  SPIRV_STAGE_GS,
+};
+// glslang is initialized by the first call and kept until the process exits.
+// the result is memoized by the hash of the stage and the source. the words
+// stay valid until the process exits. nullptr on error. thread safe
+SPIRV_UTIL_API const unsigned int *
+SPIRV_Compile(SpirvStage stage, const char *src, unsigned int *out_size);
+// compile the stages concurrently. out_words[i] is nullptr on error
+SPIRV_UTIL_API void SPIRV_CompileStages(unsigned int count,
+                                        const SpirvStage *stages,
+                                        const char *const *srcs,
+                                        const unsigned int **out_words,
+                                        unsigned int *out_sizes);
+// error of the last failed SPIRV_Compile on this thread
+SPIRV_UTIL_API const char *SPIRV_GetLastError();
+// also memoize in dir. nullptr disables
+SPIRV_UTIL_API void SPIRV_SetCacheDir(const char *dir);
+
 // struct SpirvLinker;
 // SPIRV_UTIL_API SpirvLinker *SPIRV_LINER_Create();
 // SPIRV_UTIL_API void SPIRV_LINER_Destroy();
@@ -0,0 +1,161 @@
+#include "blockcodec.h"
+#include <algorithm>
+#include <string.h>
+
+namespace blockcodec {
+
+const size_t MIN_MATCH = 4;
+// the last 5 bytes are always literals
+const size_t LAST_LITERALS = 5;
+// the last match must start at least 12 bytes before the end
+const size_t MF_LIMIT = 12;
+const size_t MAX_OFFSET = 0xFFFF;
+const int HASH_BITS = 12;
+
+static uint32_t Read32(const uint8_t *p) {
+  uint32_t value;
+  memcpy(&value, p, 4);
+  return value;
+}
+
+static uint32_t Hash(uint32_t value) {
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void WriteLength(std::vector<uint8_t> &dst, size_t len) {
+  for (; len >= 255; len -= 255) {
+    dst.push_back(255);
+  }
+  dst.push_back(static_cast<uint8_t>(len));
+}
+
+static void WriteSequence(std::vector<uint8_t> &dst, const uint8_t *literals,
+                          size_t literal_length, size_t offset,
+                          size_t match_length) {
+  auto token_pos = dst.size();
+  dst.push_back(0);
+  uint8_t token = static_cast<uint8_t>(std::min<size_t>(literal_length, 15))
+                  << 4;
+  if (literal_length >= 15) {
+    WriteLength(dst, literal_length - 15);
+  }
+  dst.insert(dst.end(), literals, literals + literal_length);
+
+  if (match_length) {
+    dst.push_back(static_cast<uint8_t>(offset));
+    dst.push_back(static_cast<uint8_t>(offset >> 8));
+    auto length = match_length - MIN_MATCH;
+    token |= static_cast<uint8_t>(std::min<size_t>(length, 15));
+    if (length >= 15) {
+      WriteLength(dst, length - 15);
+    }
+  }
+  dst[token_pos] = token;
+}
+
+size_t Compress(std::span<const uint8_t> src, std::vector<uint8_t> &dst) {
+  auto begin = dst.size();
+  auto p = src.data();
+  auto n = src.size();
+  size_t anchor = 0;
+
+  if (n > MF_LIMIT) {
+    std::vector<uint32_t> table(1 << HASH_BITS);
+    auto limit = n - MF_LIMIT;
+    auto match_limit = n - LAST_LITERALS;
+    size_t i = 0;
+    while (i < limit) {
+      auto value = Read32(p + i);
+      auto h = Hash(value);
+      size_t ref = table[h];
+      table[h] = static_cast<uint32_t>(i);
+      if (ref >= i || i - ref > MAX_OFFSET || Read32(p + ref) != value) {
+        ++i;
+        continue;
+      }
+
+      auto length = MIN_MATCH;
+      while (i + length < match_limit && p[ref + length] == p[i + length]) {
+        ++length;
+      }
+      while (i > anchor && ref > 0 && p[i - 1] == p[ref - 1]) {
+        --i;
+        --ref;
+        ++length;
+      }
+
+      WriteSequence(dst, p + anchor, i - anchor, i - ref, length);
+      i += length;
+      anchor = i;
+      if (i - 2 < limit) {
+        table[Hash(Read32(p + i - 2))] = static_cast<uint32_t>(i - 2);
+      }
+    }
+  }
+
+  WriteSequence(dst, p + anchor, n - anchor, 0, 0);
+  return dst.size() - begin;
+}
+
+static bool ReadLength(std::span<const uint8_t> src, size_t *ip,
+                       size_t *length) {
+  uint8_t b;
+  do {
+    if (*ip >= src.size()) {
+      return false;
+    }
+    b = src[(*ip)++];
+    *length += b;
+  } while (b == 255);
+  return true;
+}
+
+bool Decompress(std::span<const uint8_t> src, std::span<uint8_t> dst) {
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < src.size()) {
+    auto token = src[ip++];
+
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !ReadLength(src, &ip, &literal_length)) {
+      return false;
+    }
+    if (ip + literal_length > src.size() ||
+        op + literal_length > dst.size()) {
+      return false;
+    }
+    if (literal_length) {
+      memcpy(dst.data() + op, src.data() + ip, literal_length);
+    }
+    ip += literal_length;
+    op += literal_length;
+    if (ip == src.size()) {
+      // last sequence
+      return op == dst.size();
+    }
+
+    if (ip + 2 > src.size()) {
+      return false;
+    }
+    size_t offset = src[ip] | src[ip + 1] << 8;
+    ip += 2;
+    if (offset == 0 || offset > op) {
+      return false;
+    }
+    size_t match_length = token & 15;
+    if (match_length == 15 && !ReadLength(src, &ip, &match_length)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (op + match_length > dst.size()) {
+      return false;
+    }
+    // may overlap
+    for (size_t i = 0; i < match_length; ++i, ++op) {
+      dst[op] = dst[op - offset];
+    }
+  }
+  return false;
+}
+
+} // namespace blockcodec
@@ -0,0 +1,15 @@
+#pragma once
+#include <span>
+#include <stdint.h>
+#include <vector>
+
+/// LZ4 block format compatible codec.
+/// fast and good enough for terminal text.
+namespace blockcodec {
+
+// append compressed src to dst. returns compressed size
+size_t Compress(std::span<const uint8_t> src, std::vector<uint8_t> &dst);
+// dst.size() must be the uncompressed size
+bool Decompress(std::span<const uint8_t> src, std::span<uint8_t> dst);
+
+} // namespace blockcodec
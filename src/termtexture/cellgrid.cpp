@@ -1,364 +1,89 @@
 #include "cellgrid.h"
 #include "celltypes.h"
 #include "fontatlas.h"
+#include "trace.h"
 #include "vterm.h"
+#include <algorithm>
 #include <chrono>
-#include <gl/glew.h>
-#include <glo/scoped_binder.h>
-#include <glo/shader.h>
-#include <glo/texture.h>
-#include <glo/ubo.h>
-#include <glo/vao.h>
-#include <ios>
+#include <cmath>
 #include <memory>
-#include <plog/Log.h>
 #include <stdint.h>
 #include <string>
-#include <type_traits>
 #include <unordered_map>
 
-auto vs_src = R"(#version 420
-in vec3 i_Pos;
-in vec4 i_Color;
-in vec4 i_BgColor;
-out vData { 
-  vec4 color; 
-  vec4 bgColor;
-}
-vertex;
-void main() {
-  gl_Position = vec4(i_Pos, 1);
-  vertex.color = i_Color;
-  vertex.bgColor = i_BgColor;
-}
-)";
-
-auto gs_src = R"(#version 420 core
-layout(points) in;
-layout(triangle_strip, max_vertices = 10) out;
-
-layout(std140, binding = 0) uniform Global {
-  mat4 projection;
-  vec2 screenSize;
-  vec2 cellSize;
-  vec2 atlasSize;
-  float ascent;
-  float descent;
-}
-global;
-
-struct Glyph {
-  vec4 xywh;
-  vec4 offset;
-};
-
-layout(std140, binding = 1) uniform Glyphs { Glyph glyphs[128]; };
-
-in vData { 
-  vec4 color; 
-  vec4 bgColor;
-}
-vertices[];
-out vec2 g_TexCoords;
-out vec4 g_Color;
-
-vec2 pixelToUv(float x, float y) {
-  return vec2((x + 0.5) / global.atlasSize.x, (y + 0.5) / global.atlasSize.y);
-}
-
-// -1+1 +1+1
-//  0+----+2
-//   |   /|
-//   |  / |
-//   | /  |
-//   |/   |
-//  1+----+3
-// -1-1 +1-1
-void main() {
-  vec2 cellSize = global.cellSize;
-  vec2 topLeft = gl_in[0].gl_Position.xy * cellSize;
-  int glyphIndex = int(gl_in[0].gl_Position.z);
-  Glyph glyph = glyphs[glyphIndex];
-  float l = glyph.xywh.x;
-  float t = glyph.xywh.y;
-  float r = glyph.xywh.z;
-  float b = glyph.xywh.w;
-
-  float w = r - l;
-  float h = b - t;
-  vec2 glyph_offset = vec2(glyph.offset.x, glyph.offset.y + global.ascent);
-  vec4 cell_0 = vec4(topLeft + glyph_offset + vec2(0, 0), 0, 1);
-  vec4 cell_1 = vec4(topLeft + glyph_offset + vec2(0, h), 0, 1);
-  vec4 cell_2 = vec4(topLeft + glyph_offset + vec2(w, 0), 0, 1);
-  vec4 cell_3 = vec4(topLeft + glyph_offset + vec2(w, h), 0, 1);
-
-  vec4 expand_0 = vec4(topLeft + vec2(0, 0), -0.1, 1);
-  vec4 expand_1 = vec4(topLeft + vec2(0, cellSize.y), -0.1, 1);
-  vec4 expand_2 = vec4(topLeft + vec2(cellSize.x, 0), -0.1, 1);
-  vec4 expand_3 = vec4(topLeft + vec2(cellSize.x, cellSize.y), -0.1, 1);
-
-  //
-  Glyph fill_glyph = glyphs[1];
-  float fl = fill_glyph.xywh.x+2;
-  float ft = fill_glyph.xywh.y+2;
-  float fr = fill_glyph.xywh.z-2;
-  float fb = fill_glyph.xywh.w-2;
-
-  // 0
-  gl_Position = global.projection * expand_0;
-  g_TexCoords = pixelToUv(fl, ft);
-  g_Color = vertices[0].bgColor;
-  EmitVertex();
-
-  // 1
-  gl_Position = global.projection * expand_1;
-  g_TexCoords = pixelToUv(fl, fb);
-  g_Color = vertices[0].bgColor;
-  EmitVertex();
-
-  // 2
-  gl_Position = global.projection * expand_2;
-  g_TexCoords = pixelToUv(fr, ft);
-  g_Color = vertices[0].bgColor;
-  EmitVertex();
-
-  // 3
-  gl_Position = global.projection * expand_3;
-  g_TexCoords = pixelToUv(fr, fb);
-  g_Color = vertices[0].bgColor;
-  EmitVertex();
-
-  // 3 dummy
-  gl_Position = global.projection * expand_3;
-  EmitVertex();
-
-  // 0 dummy
-  gl_Position = global.projection * cell_0;
-  EmitVertex();
-
-  // 0
-  gl_Position = global.projection * cell_0;
-  g_TexCoords = pixelToUv(l, t);
-  g_Color = vertices[0].color;
-  EmitVertex();
-
-  // 1
-  gl_Position = global.projection * cell_1;
-  g_TexCoords = pixelToUv(l, b);
-  g_Color = vertices[0].color;
-  EmitVertex();
-
-  // 2
-  gl_Position = global.projection * cell_2;
-  g_TexCoords = pixelToUv(r, t);
-  g_Color = vertices[0].color;
-  EmitVertex();
-
-  // 3
-  gl_Position = global.projection * cell_3;
-  g_TexCoords = pixelToUv(r, b);
-  g_Color = vertices[0].color;
-  EmitVertex();
-
-  EndPrimitive();
-}
-)";
+CellGrid::CellGrid() : backend_(NullBackend::Create()) {}
 
-auto fs_src = R"(#version 460 core
+CellGrid::~CellGrid() {}
 
-in vec2 g_TexCoords;
-in vec4 g_Color;
-layout(location = 0) out vec4 FragColor;
-uniform sampler2D uTex;
-
-void main() {
-  vec4 texcel = texture(uTex, g_TexCoords);
-  FragColor = vec4(g_Color.rgb, texcel.x);
-  // FragColor = vec4(TexCoords, 0, 1);
+std::shared_ptr<CellGrid> CellGrid::Create() {
+  return std::shared_ptr<CellGrid>(new CellGrid);
 }
-)";
-
-struct Glyphs {
-  Glyph glyphs[128];
-};
-
-struct Global {
-  float projection[16] = {
-      1, 0, 0, 0, //
-      0, 1, 0, 0, //
-      0, 0, 1, 0, //
-      0, 0, 0, 1  //
-
-  };
-  float screenSize[2];
-  float cellSize[2];
-  float atlasSize[2];
-  float ascent;
-  float descent;
-
-  void UpdateProjection(PixelSize screen_size, PixelSize cell_size) {
-    auto m = projection;
-    m[0] = 2.0 / screen_size.width;
-    m[5] = -(2.0 / screen_size.height);
-    m[12] = -1 - cell_size.width / screen_size.width * 2;
-    m[13] = 1 + cell_size.height / screen_size.height * 2;
-  }
-};
-
-class TextImpl {
-  std::shared_ptr<glo::VAO> vao_;
-  glo::TypedUBO<Global> ubo_global_;
-  glo::TypedUBO<Glyphs> ubo_glyphs_;
-  std::shared_ptr<glo::ShaderProgram> shader_;
-  std::shared_ptr<glo::Texture> font_;
-
-public:
-  FontAtlas atlas_;
-  bool Initialize() {
-    shader_ = glo::ShaderProgram::Create({vs_src, fs_src, gs_src, false});
-    if (!shader_) {
-      return false;
-    }
-
-    ubo_global_.Initialize();
-    ubo_glyphs_.Initialize();
-
-    // vertex buffer
-    auto vbo = glo::VBO::Create();
-    glo::VertexLayout layouts[] = {
-        {{"i_Pos", 0}, GL_FLOAT, 3, 20, 0},
-        {{"i_Color", 1}, GL_UNSIGNED_BYTE, 4, 20, 12},
-        {{"i_BgColor", 2}, GL_UNSIGNED_BYTE, 4, 20, 16},
-    };
-    vao_ = glo::VAO::Create(vbo, layouts);
-
-    return true;
-  }
-
-  bool LoadFont(std::string_view path, PixelSize cell_size, uint32_t atlas_size) {
-    FontLoader font;
-    if (!font.Load(path, static_cast<float>(cell_size.height))) {
-      return false;
-    }
-    atlas_.info = font.info;
-
-    PLOG_INFO << path << std::endl;
-
-    // make a most likely large enough bitmap, adjust to font type, number of
-    // sizes and glyphs and oversampling
-    auto atlas_width = atlas_size;
-    auto atlas_height = atlas_size;
-    std::vector<uint8_t> atlas_bitmap(atlas_width * atlas_height);
-    assert(atlas_bitmap.size());
-
-    GlyphPackRange ranges[] = {
-        {
-            .codepoint = 0x20, // space
-            .length = 1,
-        },
-        {
-            .codepoint = 0x25A0, // black square
-            .length = 1,
-        },
-        {
-            .codepoint = 33,
-            .length = 95,
-        },
-    };
-    atlas_.Pack(atlas_bitmap.data(), atlas_width, atlas_height, &font, ranges);
-    atlas_.glyphs[0].offset.expand = 1;
-
-    font_ = glo::Texture::Create(atlas_width, atlas_height, GL_RED,
-                                 atlas_bitmap.data());
-    auto label = "atlas";
-    if ((__GLEW_EXT_debug_label)) {
-      glLabelObjectEXT(GL_TEXTURE, font_->Handle(), 0, label);
-    }
-    if ((__GLEW_KHR_debug)) {
-      glObjectLabel(GL_TEXTURE, font_->Handle(), -1, label);
-    }
-
-    // ubo_glyph
-    for (int i = 0; i < atlas_.glyphs.size(); ++i) {
-      auto &g = atlas_.glyphs[i];
-      ubo_glyphs_.buffer.glyphs[i] = g;
-    }
-    ubo_glyphs_.Upload();
-
-    // ubo_global
-    ubo_global_.buffer.atlasSize[0] = (float)atlas_width;
-    ubo_global_.buffer.atlasSize[1] = (float)atlas_height;
-    ubo_global_.buffer.ascent = atlas_.info.ascents;
-    ubo_global_.buffer.descent = atlas_.info.descents;
 
-    return true;
+void CellGrid::SetBackend(const std::shared_ptr<RenderBackend> &backend) {
+  backend_ = backend;
+  backend_->Resize(rows_, cols_);
+  if (atlas_) {
+    backend_->LoadAtlas(atlas_, cell_size_);
   }
-
-  void Commit(std::span<CellVertex> cells) {
-    vao_->GetVBO()->DataFromSpan(cells, true);
-  }
-
-  void Render(PixelSize screen_size, std::chrono::nanoseconds duration,
-              PixelSize cell_size, int draw_count) {
-    if (!font_) {
-      return;
-    }
-
-    {
-      // ubo_global
-      ubo_global_.buffer.cellSize[0] = (float)cell_size.width;
-      ubo_global_.buffer.cellSize[1] = (float)cell_size.height;
-      ubo_global_.buffer.screenSize[0] = (float)screen_size.width;
-      ubo_global_.buffer.screenSize[1] = (float)screen_size.height;
-      ubo_global_.buffer.UpdateProjection(screen_size, cell_size);
-      ubo_global_.Upload();
-    }
-
-    {
-      auto shader_scope = ScopedBind(shader_);
-      auto texture_scope = ScopedBind(font_);
-      glEnable(GL_BLEND);
-      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-      {
-        shader_->SetUBO(0, ubo_global_.Handle());
-        shader_->SetUBO(1, ubo_glyphs_.Handle());
-        vao_->Draw(GL_POINTS, 0, draw_count);
-      }
-    }
+  // upload everything again
+  changed_.clear();
+  for (uint32_t i = 0; i < cells_.size(); ++i) {
+    changed_.push_back(i);
   }
-};
-
-//
-// Text
-//
-CellGrid::CellGrid() : impl_(new TextImpl) {}
-
-CellGrid::~CellGrid() { delete (impl_); }
-
-std::shared_ptr<CellGrid> CellGrid::Create() {
-  return std::shared_ptr<CellGrid>(new CellGrid);
+  InvalidateHistory();
+  history_cols_ = 0;
 }
 
-bool CellGrid::Load(std::string_view path, PixelSize cell_size, uint32_t atlas_size) {
-  if (!impl_->Initialize()) {
+bool CellGrid::Load(std::string_view path, PixelSize cell_size,
+                    uint32_t atlas_size) {
+  auto atlas = std::make_shared<FontAtlas>();
+  if (!atlas->Load(path, cell_size, atlas_size)) {
     return false;
   }
+  return SetAtlas(atlas, cell_size);
+}
 
+bool CellGrid::SetAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                        PixelSize cell_size) {
+  atlas_ = atlas;
   cell_size_ = cell_size;
-
-  return impl_->LoadFont(path, cell_size, atlas_size);
+  return backend_->LoadAtlas(atlas_, cell_size);
 }
 
 void CellGrid::Clear() {
   cellMap_.clear();
   cells_.clear();
+  changed_.clear();
 }
 
-void CellGrid::SetCell(CellPos pos, const VTermScreenCell &cell) {
+void CellGrid::Resize(int rows, int cols) {
+  if (rows == rows_ && cols == cols_) {
+    return;
+  }
+  rows_ = rows;
+  cols_ = cols;
+  Clear();
+  backend_->Resize(rows, cols);
+}
+
+static void SetVertexCell(const FontAtlas *atlas, const VTermScreenCell &cell,
+                          CellVertex &v) {
   size_t i = 0;
   for (; i < VTERM_MAX_CHARS_PER_CELL && cell.chars[i]; ++i) {
   }
-  auto glyph_index = impl_->atlas_.GlyphIndexFromCodePoint({cell.chars, i});
+  v.glyph_index =
+      atlas ? (float)atlas->GlyphIndexFromCodePoint({cell.chars, i}) : 0;
+  v.fg_color[0] = cell.fg.rgb.red;
+  v.fg_color[1] = cell.fg.rgb.green;
+  v.fg_color[2] = cell.fg.rgb.blue;
+  v.fg_color[3] = 255;
+  v.bg_color[0] = cell.bg.rgb.red;
+  v.bg_color[1] = cell.bg.rgb.green;
+  v.bg_color[2] = cell.bg.rgb.blue;
+  v.bg_color[3] = 255;
+}
+
+void CellGrid::SetCell(CellPos pos, const VTermScreenCell &cell) {
   auto found = cellMap_.find(pos);
   size_t index;
   if (found != cellMap_.end()) {
@@ -372,21 +97,72 @@ void CellGrid::SetCell(CellPos pos, const VTermScreenCell &cell) {
     cellMap_.insert(std::make_pair(pos, index));
   }
 
-  auto &v = cells_[index];
-  v.glyph_index = (float)glyph_index;
-  v.fg_color[0] = cell.fg.rgb.red;
-  v.fg_color[1] = cell.fg.rgb.green;
-  v.fg_color[2] = cell.fg.rgb.blue;
-  v.fg_color[3] = 255;
-  v.bg_color[0] = cell.bg.rgb.red;
-  v.bg_color[1] = cell.bg.rgb.green;
-  v.bg_color[2] = cell.bg.rgb.blue;
-  v.bg_color[3] = 255;
+  SetVertexCell(atlas_.get(), cell, cells_[index]);
+  changed_.push_back(static_cast<uint32_t>(index));
+}
+
+void CellGrid::Commit() {
+  TRACE_SCOPE("CellGrid::Commit");
+  backend_->UpdateCells(cells_, changed_);
+  changed_.clear();
 }
 
-void CellGrid::Commit() { impl_->Commit(cells_); }
+void CellGrid::InvalidateHistory() {
+  std::fill(history_slots_.begin(), history_slots_.end(), -1);
+}
+
+void CellGrid::SetScroll(uint64_t history_end, double scroll_rows, int rows,
+                         int cols, const FetchLine &fetch) {
+  scroll_rows = std::clamp(scroll_rows, 0.0, static_cast<double>(history_end));
+  if (scroll_rows <= 0) {
+    backend_->SetScroll(0, std::max(1, history_rows_), 0, {});
+    return;
+  }
+
+  // the top partial row and the rows below
+  auto lines = static_cast<int64_t>(std::ceil(scroll_rows));
+  auto count = std::min<int64_t>(lines, rows + 1);
+  if (cols != history_cols_ || count > history_rows_) {
+    history_cols_ = cols;
+    history_rows_ = std::max(HISTORY_ROWS, static_cast<int>(count));
+    history_slots_.assign(history_rows_, -1);
+    history_vertices_.resize(cols);
+    backend_->AllocateHistory(history_rows_, cols);
+  }
+
+  auto first = static_cast<int64_t>(history_end) - lines;
+  for (auto line = first; line < first + count; ++line) {
+    auto slot = static_cast<int>(line % history_rows_);
+    if (history_slots_[slot] == line) {
+      continue;
+    }
+    // ring miss
+    fetch(line, history_cells_);
+    for (int col = 0; col < cols; ++col) {
+      auto &v = history_vertices_[col];
+      v.col = (float)col;
+      v.row = (float)-(slot + 1);
+      if (static_cast<size_t>(col) < history_cells_.size()) {
+        SetVertexCell(atlas_.get(), history_cells_[col], v);
+      } else {
+        SetVertexCell(atlas_.get(), {}, v);
+      }
+    }
+    backend_->UpdateHistoryRow(slot, history_vertices_);
+    history_slots_[slot] = line;
+  }
+
+  auto anchor = static_cast<int>(first % history_rows_);
+  auto head = std::min<int64_t>(count, history_rows_ - anchor);
+  HistoryRange ranges[] = {
+      {anchor * cols, static_cast<int>(head * cols)},
+      {0, static_cast<int>((count - head) * cols)},
+  };
+  backend_->SetScroll(static_cast<float>(scroll_rows), history_rows_, anchor,
+                   ranges);
+}
 
 void CellGrid::Render(PixelSize screen_size,
                       std::chrono::nanoseconds duration) {
-  impl_->Render(screen_size, duration, cell_size_, cells_.size());
+  backend_->Render(screen_size, cell_size_, duration);
 }
@@ -1,20 +1,17 @@
+#pragma once
 #include "celltypes.h"
+#include "fontatlas.h"
+#include "render_backend.h"
 #include "vterm.h"
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <span>
 #include <stdint.h>
 #include <string>
 #include <string_view>
 #include <unordered_map>
-
-struct CellVertex {
-  float col;
-  float row;
-  float glyph_index;
-  uint8_t fg_color[4];
-  uint8_t bg_color[4];
-};
+#include <vector>
 
 /// Windows, Texture, Screen: PixelSize
 /// Term: TermSize(rows, cols)
@@ -26,7 +23,23 @@ class CellGrid {
   };
   std::vector<CellVertex> cells_;
   std::unordered_map<CellPos, size_t, std::hash<CellPos>> cellMap_;
-  class TextImpl *impl_ = nullptr;
+  // indices in cells_ since the last Commit
+  std::vector<uint32_t> changed_;
+  int rows_ = 0;
+  int cols_ = 0;
+  // may be shared with other terminals
+  std::shared_ptr<const FontAtlas> atlas_;
+  std::shared_ptr<RenderBackend> backend_;
+
+  static const int HISTORY_ROWS = 512;
+  // ring of scrollback lines in the backend. slot = line % history_rows_.
+  // scrolling only updates the scroll uniforms unless the ring misses.
+  int history_rows_ = 0;
+  int history_cols_ = 0;
+  // absolute line number in each slot. -1 is empty
+  std::vector<int64_t> history_slots_;
+  std::vector<CellVertex> history_vertices_;
+  std::vector<VTermScreenCell> history_cells_;
 
 public:
   CellGrid();
@@ -37,10 +50,26 @@ public:
   CellGrid(const CellGrid &) = delete;
   CellGrid &operator=(const CellGrid &) = delete;
   PixelSize CellSize() const { return cell_size_; }
+  // NullBackend until set
+  void SetBackend(const std::shared_ptr<RenderBackend> &backend);
+  const std::shared_ptr<RenderBackend> &Backend() const { return backend_; }
+  // an atlas of this grid only
   bool Load(std::string_view path, PixelSize cell_size, uint32_t atlas_size);
+  bool SetAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                PixelSize cell_size);
   void Clear();
+  // clear if changed
+  void Resize(int rows, int cols);
   void SetCell(CellPos pos, const VTermScreenCell &cell);
   void PushText(const std::u32string &unicodes);
   void Commit();
+  // cells of an absolute scrollback line
+  using FetchLine =
+      std::function<void(uint64_t line, std::vector<VTermScreenCell> &cells)>;
+  // show scroll_rows(fractional) of history above the screen.
+  // history_end is the absolute line number next to the last scrollback line
+  void SetScroll(uint64_t history_end, double scroll_rows, int rows, int cols,
+                 const FetchLine &fetch);
+  void InvalidateHistory();
   void Render(PixelSize screen_size, std::chrono::nanoseconds duration);
 };
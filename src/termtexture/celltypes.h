@@ -1,4 +1,6 @@
 #pragma once
+#include <functional>
+#include <stddef.h>
 #include <stdint.h>
 #include <type_traits>
 
@@ -25,3 +27,19 @@ struct CellPos {
 template <> struct std::hash<CellPos> {
   std::size_t operator()(const CellPos &p) const noexcept { return p.value(); }
 };
+
+struct SearchOptions {
+  // ASCII only
+  bool ignore_case = false;
+  // ECMAScript
+  bool regex = false;
+  size_t max_results = 10000;
+};
+
+/// row < 0 is scrollback. -1 is the newest scrollback line.
+/// col and length are in cells.
+struct SearchMatch {
+  int64_t row;
+  int col;
+  int length;
+};
@@ -1,8 +1,14 @@
 #pragma once
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <span>
+#include <string>
 
 namespace common_pty {
 
+class WriteStream;
+
 class Pty {
   struct CommonPtyImpl *impl_ = nullptr;
 
@@ -14,8 +20,27 @@ public:
   bool IsClosed();
   void Kill();
   void NotifyTermSize(unsigned short rows, unsigned short cols);
+  // queued for the writer thread. never blocks. dropped with a warning if the
+  // queue is full
   void Write(const char *s, size_t len);
+  // stream a large write, e.g. a paste, in the background. later writes
+  // follow it. nullptr before Launch
+  std::shared_ptr<WriteStream> StreamWrite(std::string data,
+                                           std::string suffix = {});
   std::span<char> Read();
+  // block until output is ready to Read or timeout. true if ready
+  bool WaitOutput(std::chrono::microseconds timeout);
+  // posix. the master side. -1 before Launch or on windows
+  int Fd() const;
+  // posix. no reader thread. Read() reads the fd without blocking after
+  // SetReady, then calls on_read. for PtySessions. call before Launch
+  void SetPolled(const std::function<void()> &on_read);
+  // polled. the fd has output or hung up. Read() reads the fd only after it,
+  // so a pty without output stays armed. thread safe
+  void SetReady();
+  // called on the reader thread when output is queued to an empty queue and
+  // when the child exits. call before Launch
+  void SetOnOutput(const std::function<void()> &on_output);
 };
 
 } // namespace common_pty
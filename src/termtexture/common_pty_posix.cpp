@@ -0,0 +1,299 @@
+#include "common_pty.h"
+#include "pty_write_queue.h"
+#include "trace.h"
+#include <atomic>
+#include <condition_variable>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <plog/Log.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#if defined(__APPLE__)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+namespace common_pty {
+
+// read at most per Read() in polled mode. the rest is left for the next frame
+const size_t MAX_READ = 1024 * 1024;
+
+// SIGHUP, then SIGKILL if the child is still there a second later. waited on
+// a detached thread, so the caller does not block and no zombie is left
+static void Reap(pid_t pid) {
+  kill(pid, SIGHUP);
+  if (waitpid(pid, nullptr, WNOHANG) != 0) {
+    return;
+  }
+  std::thread([pid]() {
+    for (int i = 0; i < 100; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      if (waitpid(pid, nullptr, WNOHANG) != 0) {
+        return;
+      }
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+  }).detach();
+}
+
+struct CommonPtyImpl {
+  int fd_ = -1;
+  pid_t pid_ = -1;
+  bool closed_ = false;
+
+  // reader thread
+  std::thread reader_;
+  std::atomic<bool> stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::vector<char> queue_;
+
+  std::function<void()> on_output_;
+
+  // polled
+  std::function<void()> on_read_;
+  // the loop saw output or a hang up since the last Read
+  std::atomic<bool> ready_ = false;
+
+  std::vector<char> tmp_;
+
+  std::unique_ptr<WriteQueue> writer_;
+  bool dropping_ = false;
+
+  ~CommonPtyImpl() {
+    // the writer polls fd_
+    writer_ = nullptr;
+    stop_ = true;
+    if (reader_.joinable()) {
+      reader_.join();
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    if (pid_ > 0 && !closed_) {
+      Reap(pid_);
+    }
+  }
+
+  bool Launch(int rows, int cols, const char *cmd, const char *TERM) {
+    winsize size{
+        .ws_row = static_cast<unsigned short>(rows),
+        .ws_col = static_cast<unsigned short>(cols),
+    };
+    int fd;
+    auto pid = forkpty(&fd, nullptr, nullptr, &size);
+    if (pid < 0) {
+      PLOG_ERROR << "forkpty: " << strerror(errno);
+      return false;
+    }
+    if (pid == 0) {
+      // child
+      setenv("TERM", TERM, 1);
+      execl("/bin/sh", "sh", "-c", cmd, nullptr);
+      _exit(127);
+    }
+    fd_ = fd;
+    pid_ = pid;
+
+    // a write never blocks for a child that does not read
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    writer_ = std::make_unique<WriteQueue>(
+        [this](const char *data, size_t size) { return WriteSome(data, size); });
+    if (!on_read_) {
+      reader_ = std::thread([this]() { ReaderThread(); });
+    }
+    return true;
+  }
+
+  void ReaderThread() {
+    tracing::SetThreadName("pty reader");
+    char buffer[4096];
+    while (!stop_) {
+      pollfd pfd{.fd = fd_, .events = POLLIN};
+      // wake up for stop_
+      if (poll(&pfd, 1, 100) <= 0) {
+        continue;
+      }
+      TRACE_SCOPE("Pty::Read");
+      auto n = read(fd_, buffer, sizeof(buffer));
+      if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        continue;
+      }
+      if (n <= 0) {
+        // EIO after the child exits
+        break;
+      }
+      bool was_empty;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        was_empty = queue_.empty();
+        queue_.insert(queue_.end(), buffer, buffer + n);
+      }
+      queued_.notify_all();
+      if (was_empty && on_output_) {
+        on_output_();
+      }
+    }
+    // IsClosed
+    if (!stop_ && on_output_) {
+      on_output_();
+    }
+  }
+
+  std::span<char> Read() {
+    tmp_.clear();
+    if (fd_ < 0) {
+      return {};
+    }
+    if (!on_read_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::swap(tmp_, queue_);
+      return tmp_;
+    }
+
+    // not reported by the loop. still armed
+    if (!ready_.exchange(false)) {
+      return {};
+    }
+    TRACE_SCOPE("Pty::Read");
+    while (tmp_.size() < MAX_READ) {
+      auto size = tmp_.size();
+      tmp_.resize(size + 4096);
+      auto n = read(fd_, tmp_.data() + size, 4096);
+      tmp_.resize(size + std::max<ssize_t>(n, 0));
+      if (n <= 0) {
+        break;
+      }
+    }
+    // arm the loop again
+    on_read_();
+    return tmp_;
+  }
+
+  bool WaitOutput(std::chrono::microseconds timeout) {
+    if (fd_ < 0) {
+      return false;
+    }
+    if (!on_read_) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      return queued_.wait_for(lock, timeout, [this] { return !queue_.empty(); });
+    }
+    // round up to milliseconds
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(timeout);
+    pollfd pfd{.fd = fd_, .events = POLLIN};
+    if (poll(&pfd, 1, static_cast<int>(ms.count())) <= 0) {
+      return false;
+    }
+    // before the loop reports it
+    ready_ = true;
+    return true;
+  }
+
+  // on the writer thread
+  int64_t WriteSome(const char *data, size_t size) {
+    pollfd pfd{.fd = fd_, .events = POLLOUT};
+    // return now and then for ~WriteQueue
+    if (poll(&pfd, 1, 100) <= 0) {
+      return 0;
+    }
+    auto n = write(fd_, data, size);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EINTR) {
+        return 0;
+      }
+      PLOG_ERROR << "write: " << strerror(errno);
+      return -1;
+    }
+    return n;
+  }
+
+  void Write(const char *s, size_t len) {
+    if (!writer_) {
+      return;
+    }
+    if (writer_->Push(s, len)) {
+      dropping_ = false;
+    } else if (!dropping_) {
+      // once until the queue has room again
+      if (writer_->IsBroken()) {
+        PLOG_WARNING << "pty write failed earlier. dropping input";
+      } else {
+        PLOG_WARNING << "pty write queue is full. dropping input";
+      }
+      dropping_ = true;
+    }
+  }
+
+  bool IsClosed() {
+    if (pid_ <= 0 || closed_) {
+      return closed_;
+    }
+    int status;
+    if (waitpid(pid_, &status, WNOHANG) == pid_) {
+      closed_ = true;
+    }
+    return closed_;
+  }
+
+  void NotifyTermSize(unsigned short rows, unsigned short cols) {
+    if (fd_ < 0) {
+      return;
+    }
+    winsize size{.ws_row = rows, .ws_col = cols};
+    ioctl(fd_, TIOCSWINSZ, &size);
+  }
+};
+
+Pty::Pty() : impl_(new CommonPtyImpl) {}
+Pty::~Pty() {
+  if (impl_) {
+    delete impl_;
+    impl_ = nullptr;
+  }
+}
+
+void Pty::Launch(int rows, int cols, const char *cmd, const char *TERM) {
+  impl_->Launch(rows, cols, cmd, TERM);
+}
+
+bool Pty::IsClosed() { return impl_->IsClosed(); }
+void Pty::Kill() {
+  if (impl_->pid_ > 0) {
+    kill(impl_->pid_, SIGKILL);
+  }
+}
+void Pty::Write(const char *buf, size_t size) { impl_->Write(buf, size); }
+void Pty::NotifyTermSize(unsigned short rows, unsigned short cols) {
+  impl_->NotifyTermSize(rows, cols);
+}
+int Pty::Fd() const { return impl_->fd_; }
+void Pty::SetPolled(const std::function<void()> &on_read) {
+  impl_->on_read_ = on_read;
+}
+void Pty::SetReady() { impl_->ready_ = true; }
+void Pty::SetOnOutput(const std::function<void()> &on_output) {
+  impl_->on_output_ = on_output;
+}
+bool Pty::WaitOutput(std::chrono::microseconds timeout) {
+  return impl_->WaitOutput(timeout);
+}
+std::shared_ptr<WriteStream> Pty::StreamWrite(std::string data,
+                                              std::string suffix) {
+  if (!impl_->writer_) {
+    return nullptr;
+  }
+  return impl_->writer_->Stream(std::move(data), std::move(suffix));
+}
+std::span<char> Pty::Read() { return impl_->Read(); }
+
+} // namespace common_pty
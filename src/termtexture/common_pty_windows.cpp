@@ -1,6 +1,9 @@
 #include "common_pty.h"
+#include "pty_write_queue.h"
+#include "trace.h"
 #include <Windows.h>
 #include <algorithm>
+#include <condition_variable>
 #include <iostream>
 #include <mutex>
 #include <plog/Log.h>
@@ -19,18 +22,28 @@ namespace common_pty {
 struct LockedInputQueue {
   std::vector<char> buffer_;
   std::mutex mtx_;
+  std::condition_variable queued_;
 
-  void Enqueue(const char *buf, DWORD len) {
+  // true if the queue was empty
+  bool Enqueue(const char *buf, DWORD len) {
     if (len == 0) {
-      return;
+      return false;
     }
 
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::unique_lock<std::mutex> lock(mtx_);
     auto size = buffer_.size();
     buffer_.resize(size + len);
     memcpy(buffer_.data() + size, buf, len);
+    lock.unlock();
+    queued_.notify_all();
 
     // PLOG_DEBUG << size << " << " << len;
+    return size == 0;
+  }
+
+  bool Wait(std::chrono::microseconds timeout) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    return queued_.wait_for(lock, timeout, [this] { return !buffer_.empty(); });
   }
 
   auto Dequeue(std::vector<char> &buffer) {
@@ -54,6 +67,7 @@ struct CommonPtyImpl {
   PROCESS_INFORMATION piClient_{};
 
   LockedInputQueue queue_;
+  std::function<void()> on_output_;
 
   void Shutdown() {
     // Now safe to clean-up client app's process-info & thread
@@ -171,9 +185,31 @@ struct CommonPtyImpl {
 
   void Kill() { TerminateProcess(piClient_.hProcess, 9); }
 
-  void Write(const char *buf, size_t size) {
+  // on the writer thread
+  int64_t WriteSome(const char *buf, size_t size) {
     DWORD write_size;
-    WriteFile(hPipeOut_, buf, size, &write_size, NULL);
+    if (!WriteFile(hPipeOut_, buf, static_cast<DWORD>(size), &write_size,
+                   NULL)) {
+      return -1;
+    }
+    return write_size;
+  }
+
+  void Write(const char *buf, size_t size) {
+    if (!writer_) {
+      return;
+    }
+    if (writer_->Push(buf, size)) {
+      dropping_ = false;
+    } else if (!dropping_) {
+      // once until the queue has room again
+      if (writer_->IsBroken()) {
+        PLOG_WARNING << "pty write failed earlier. dropping input";
+      } else {
+        PLOG_WARNING << "pty write queue is full. dropping input";
+      }
+      dropping_ = true;
+    }
   }
 
   void NotifyTermSize(unsigned short rows, unsigned short cols) {
@@ -194,6 +230,11 @@ struct CommonPtyImpl {
     queue_.Dequeue(tmp_);
     return {tmp_.begin(), tmp_.end()};
   }
+
+  // destroyed first. WriteFile blocks while the child does not read, so the
+  // destructor cancels it
+  std::unique_ptr<WriteQueue> writer_;
+  bool dropping_ = false;
 };
 
 static void __cdecl PipeListener(LPVOID p) {
@@ -207,11 +248,19 @@ static void __cdecl PipeListener(LPVOID p) {
   DWORD dwBytesWritten{};
   DWORD dwBytesRead{};
   BOOL fRead{FALSE};
+  tracing::SetThreadName("pty reader");
   do {
-    // Read from the pipe
+    // Read from the pipe. blocks until the child writes
+    TRACE_SCOPE("Pty::Read");
     fRead = ReadFile(hPipe, szBuffer, BUFF_SIZE, &dwBytesRead, NULL);
-    impl->queue_.Enqueue(szBuffer, dwBytesRead);
+    if (impl->queue_.Enqueue(szBuffer, dwBytesRead) && impl->on_output_) {
+      impl->on_output_();
+    }
   } while (fRead && dwBytesRead >= 0);
+  // IsClosed
+  if (impl->on_output_) {
+    impl->on_output_();
+  }
 
   std::cout << "PipeListener finished." << std::endl;
 }
@@ -240,6 +289,11 @@ void Pty::Launch(int rows, int cols, const char *prog, const char *TERM) {
   if (!impl_->Launch(prog)) {
     return;
   }
+  impl_->writer_ = std::make_unique<WriteQueue>(
+      [impl = impl_](const char *data, size_t size) {
+        return impl->WriteSome(data, size);
+      },
+      [](std::thread &writer) { CancelSynchronousIo(writer.native_handle()); });
 }
 
 bool Pty::IsClosed() { return impl_->IsClosed(); }
@@ -248,6 +302,23 @@ void Pty::Write(const char *buf, size_t size) { impl_->Write(buf, size); }
 void Pty::NotifyTermSize(unsigned short rows, unsigned short cols) {
   impl_->NotifyTermSize(rows, cols);
 }
+// pipes can not be polled with the loops of PtySessions
+int Pty::Fd() const { return -1; }
+void Pty::SetPolled(const std::function<void()> &on_read) {}
+void Pty::SetReady() {}
+void Pty::SetOnOutput(const std::function<void()> &on_output) {
+  impl_->on_output_ = on_output;
+}
+bool Pty::WaitOutput(std::chrono::microseconds timeout) {
+  return impl_->queue_.Wait(timeout);
+}
+std::shared_ptr<WriteStream> Pty::StreamWrite(std::string data,
+                                              std::string suffix) {
+  if (!impl_->writer_) {
+    return nullptr;
+  }
+  return impl_->writer_->Stream(std::move(data), std::move(suffix));
+}
 std::span<char> Pty::Read() { return impl_->Read(); }
 
 } // namespace common_pty
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "cpu_rasterizer.h"
+#include "frame_stats.h"
+#include <algorithm>
+#include <plog/Log.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPU_RASTERIZER_SSE2 1
+#endif
+
+// (v + 128) / 255 rounded, for v in [0, 255 * 255]
+static inline uint32_t Div255(uint32_t v) {
+  v += 128;
+  return (v + (v >> 8)) >> 8;
+}
+
+// inlined into DrawRow. a cell line is only 8 to 16 pixels
+static inline void BlendSpan(uint8_t *dst, const uint8_t *coverage,
+                             size_t count, const uint8_t fg[4],
+                             const uint8_t bg[4]) {
+  size_t i = 0;
+#if CPU_RASTERIZER_SSE2
+  // 4 pixels per loop. 16bit lanes, 2 pixels per register.
+  // fg * a + bg * (255 - a) <= 255 * 255 fits in 16bit
+  auto zero = _mm_setzero_si128();
+  uint32_t fg32, bg32;
+  memcpy(&fg32, fg, 4);
+  memcpy(&bg32, bg, 4);
+  auto fg16 = _mm_unpacklo_epi8(_mm_set1_epi32(fg32), zero);
+  auto bg16 = _mm_unpacklo_epi8(_mm_set1_epi32(bg32), zero);
+  auto c255 = _mm_set1_epi16(255);
+  auto c128 = _mm_set1_epi16(128);
+  for (; i + 4 <= count; i += 4) {
+    uint32_t a32;
+    memcpy(&a32, coverage + i, 4);
+    if (a32 == 0) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4),
+                       _mm_set1_epi32(bg32));
+      continue;
+    }
+    // a0 a0 a0 a0 a1 a1 a1 a1 a2 ... as bytes
+    auto a = _mm_cvtsi32_si128(static_cast<int>(a32));
+    a = _mm_unpacklo_epi8(a, a);
+    a = _mm_unpacklo_epi16(a, a);
+    auto a_lo = _mm_unpacklo_epi8(a, zero);
+    auto a_hi = _mm_unpackhi_epi8(a, zero);
+
+    auto lo = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(fg16, a_lo),
+                      _mm_mullo_epi16(bg16, _mm_sub_epi16(c255, a_lo))),
+        c128);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    auto hi = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(fg16, a_hi),
+                      _mm_mullo_epi16(bg16, _mm_sub_epi16(c255, a_hi))),
+        c128);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4),
+                     _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < count; ++i) {
+    uint32_t a = coverage[i];
+    auto p = dst + i * 4;
+    for (int c = 0; c < 4; ++c) {
+      p[c] = static_cast<uint8_t>(Div255(fg[c] * a + bg[c] * (255 - a)));
+    }
+  }
+}
+
+void BlendCoverage(uint8_t *dst, const uint8_t *coverage, size_t count,
+                   const uint8_t fg[4], const uint8_t bg[4]) {
+  BlendSpan(dst, coverage, count, fg, bg);
+}
+
+CpuRasterizer::CpuRasterizer() {}
+
+CpuRasterizer::~CpuRasterizer() {}
+
+std::shared_ptr<CpuRasterizer> CpuRasterizer::Create() {
+  return std::shared_ptr<CpuRasterizer>(new CpuRasterizer);
+}
+
+bool CpuRasterizer::LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                              PixelSize cell_size) {
+  atlas_ = atlas;
+  cell_size_ = cell_size;
+  BuildTiles();
+  pixels_.resize(static_cast<size_t>(Width()) * Height() * 4);
+  std::fill(dirty_rows_.begin(), dirty_rows_.end(), 1);
+  return true;
+}
+
+void CpuRasterizer::BuildTiles() {
+  int w = cell_size_.width;
+  int h = cell_size_.height;
+  tiles_.assign(atlas_->glyphs.size() * w * h, 0);
+  for (size_t i = 0; i < atlas_->glyphs.size(); ++i) {
+    auto &g = atlas_->glyphs[i];
+    if (g.offset.expand) {
+      // background only
+      continue;
+    }
+    // xywh is x0, y0, x1, y1 in the atlas
+    int x0 = static_cast<int>(g.xywh.x);
+    int y0 = static_cast<int>(g.xywh.y);
+    int gw = static_cast<int>(g.xywh.w) - x0;
+    int gh = static_cast<int>(g.xywh.h) - y0;
+    int ox = static_cast<int>(g.offset.xoff);
+    int oy = static_cast<int>(g.offset.yoff + atlas_->info.ascents);
+    auto tile = tiles_.data() + i * w * h;
+    // clipped to the cell
+    for (int y = std::max(0, -oy); y < gh && oy + y < h; ++y) {
+      auto src = atlas_->bitmap.data() + (y0 + y) * atlas_->bitmap_width + x0;
+      for (int x = std::max(0, -ox); x < gw && ox + x < w; ++x) {
+        tile[(oy + y) * w + ox + x] = src[x];
+      }
+    }
+  }
+}
+
+void CpuRasterizer::Resize(int rows, int cols) {
+  if (rows == rows_ && cols == cols_) {
+    return;
+  }
+  rows_ = rows;
+  cols_ = cols;
+  cells_.assign(rows * cols, {});
+  dirty_rows_.assign(rows, 1);
+  pixels_.resize(static_cast<size_t>(Width()) * Height() * 4);
+}
+
+void CpuRasterizer::UpdateCells(std::span<const CellVertex> cells,
+                                std::span<const uint32_t> changed) {
+  ScopedStageTimer stage(stats_, FrameStage::BufferUpload);
+  for (auto i : changed) {
+    auto &v = cells[i];
+    int row = static_cast<int>(v.row);
+    int col = static_cast<int>(v.col);
+    if (row < 0 || row >= rows_ || col >= cols_) {
+      continue;
+    }
+    auto &c = cells_[row * cols_ + col];
+    c.glyph = static_cast<uint32_t>(v.glyph_index);
+    memcpy(c.fg, v.fg_color, 4);
+    memcpy(c.bg, v.bg_color, 4);
+    dirty_rows_[row] = 1;
+  }
+}
+
+void CpuRasterizer::Render(PixelSize screen_size, PixelSize cell_size,
+                           std::chrono::nanoseconds duration) {
+  if (tiles_.empty()) {
+    return;
+  }
+  ScopedStageTimer stage(stats_, FrameStage::Draw);
+  if (cursor_row_ >= 0 && cursor_row_ < rows_) {
+    dirty_rows_[cursor_row_] = 1;
+  }
+  cursor_row_ = -1;
+  for (int row = 0; row < rows_; ++row) {
+    if (dirty_rows_[row]) {
+      DrawRow(row);
+      dirty_rows_[row] = 0;
+    }
+  }
+}
+
+void CpuRasterizer::RenderCursor(int left, int top, int right, int bottom,
+                                 PixelSize screen_size) {
+  if (!cell_size_.height) {
+    return;
+  }
+  ScopedStageTimer stage(stats_, FrameStage::Draw);
+  left = std::max(left, 0);
+  top = std::max(top, 0);
+  right = std::min(right, Width());
+  bottom = std::min(bottom, Height());
+  for (int y = top; y < bottom; ++y) {
+    auto p = pixels_.data() + (static_cast<size_t>(y) * Width() + left) * 4;
+    for (int x = left; x < right; ++x, p += 4) {
+      p[0] = 255 - p[0];
+      p[1] = 255 - p[1];
+      p[2] = 255 - p[2];
+    }
+  }
+  cursor_row_ = top / cell_size_.height;
+}
+
+void CpuRasterizer::DrawRow(int row) {
+  int w = cell_size_.width;
+  int h = cell_size_.height;
+  size_t stride = static_cast<size_t>(Width()) * 4;
+  auto row_pixels = pixels_.data() + row * h * stride;
+  for (int col = 0; col < cols_; ++col) {
+    auto &cell = cells_[row * cols_ + col];
+    auto tile = tiles_.data() + cell.glyph * w * h;
+    auto dst = row_pixels + col * w * 4;
+    for (int y = 0; y < h; ++y) {
+      BlendSpan(dst + y * stride, tile + y * w, w, cell.fg, cell.bg);
+    }
+  }
+}
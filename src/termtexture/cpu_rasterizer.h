@@ -0,0 +1,69 @@
+#pragma once
+#include "celltypes.h"
+#include "fontatlas.h"
+#include "render_backend.h"
+#include <memory>
+#include <span>
+#include <stdint.h>
+#include <vector>
+#include <vterm.h>
+
+/// Draws the cell grid into an RGBA8 buffer without GL.
+/// Same FontAtlas bitmap as the GL path. Each glyph is pre-clipped into a
+/// cell sized coverage tile, so drawing a cell line is a single blend of
+/// coverage between bg and fg (SSE2 when available).
+/// Only rows that have changed since the last Render are redrawn.
+/// The history ring is not drawn.
+class CpuRasterizer : public RenderBackend {
+  struct Cell {
+    uint32_t glyph = 0;
+    uint8_t fg[4] = {};
+    uint8_t bg[4] = {0, 0, 0, 255};
+  };
+
+  std::shared_ptr<const FontAtlas> atlas_;
+  PixelSize cell_size_ = {};
+  // cell_size_.width * cell_size_.height per glyph
+  std::vector<uint8_t> tiles_;
+  int rows_ = 0;
+  int cols_ = 0;
+  std::vector<Cell> cells_;
+  std::vector<uint8_t> dirty_rows_;
+  // rows top to bottom
+  std::vector<uint8_t> pixels_;
+  // inverted by RenderCursor. restored by the next Render
+  int cursor_row_ = -1;
+  FrameStats *stats_ = nullptr;
+
+  CpuRasterizer();
+
+public:
+  ~CpuRasterizer();
+  CpuRasterizer(const CpuRasterizer &) = delete;
+  CpuRasterizer &operator=(const CpuRasterizer &) = delete;
+  static std::shared_ptr<CpuRasterizer> Create();
+  void SetStats(FrameStats *stats) override { stats_ = stats; }
+  bool LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                 PixelSize cell_size) override;
+  void Resize(int rows, int cols) override;
+  void UpdateCells(std::span<const CellVertex> cells,
+                   std::span<const uint32_t> changed) override;
+  // redraw dirty rows
+  void Render(PixelSize screen_size, PixelSize cell_size,
+              std::chrono::nanoseconds duration) override;
+  void RenderCursor(int left, int top, int right, int bottom,
+                    PixelSize screen_size) override;
+  PixelSize CellSize() const { return cell_size_; }
+  int Width() const { return cols_ * cell_size_.width; }
+  int Height() const { return rows_ * cell_size_.height; }
+  // RGBA8. rows are top to bottom
+  std::span<const uint8_t> Pixels() const { return pixels_; }
+
+private:
+  void BuildTiles();
+  void DrawRow(int row);
+};
+
+// dst[i] = bg + (fg - bg) * coverage[i] / 255. RGBA8
+void BlendCoverage(uint8_t *dst, const uint8_t *coverage, size_t count,
+                   const uint8_t fg[4], const uint8_t bg[4]);
@@ -3,9 +3,9 @@
 #include <vterm.h>
 #include "celltypes.h"
 
-class Cursor {
-  struct CursorImpl *impl_ = nullptr;
+class RenderBackend;
 
+class Cursor {
   Cursor();
 
 public:
@@ -13,5 +13,6 @@ public:
   Cursor(const Cursor &) = delete;
   Cursor &operator=(const Cursor &) = delete;
   static std::shared_ptr<Cursor> Create();
-  void Render(const VTermPos &pos, PixelSize screen_size, PixelSize cell_size);
+  void Render(RenderBackend &backend, const VTermPos &pos,
+              PixelSize screen_size, PixelSize cell_size);
 };
@@ -1,5 +1,8 @@
 #include "fontatlas.h"
 #include "readallbytes.h"
+#include "trace.h"
+#include "unicode.h"
+#include <assert.h>
 #include <gl/glew.h>
 #include <memory>
 #include <plog/Log.h>
@@ -38,7 +41,7 @@ bool FontLoader::Load(std::string_view path, float fontsize) {
 }
 
 size_t
-FontAtlas::GlyphIndexFromCodePoint(std::span<const uint32_t> codepoints) {
+FontAtlas::GlyphIndexFromCodePoint(std::span<const uint32_t> codepoints) const {
   if (codepoints.empty()) {
     return 0;
   }
@@ -50,8 +53,47 @@ FontAtlas::GlyphIndexFromCodePoint(std::span<const uint32_t> codepoints) {
   return found->second;
 }
 
+bool FontAtlas::Load(std::string_view path, PixelSize cell_size,
+                     uint32_t atlas_size) {
+  FontLoader font;
+  if (!font.Load(path, static_cast<float>(cell_size.height))) {
+    return false;
+  }
+  info = font.info;
+
+  PLOG_INFO << path << std::endl;
+
+  // make a most likely large enough bitmap, adjust to font type, number of
+  // sizes and glyphs and oversampling
+  bitmap_width = atlas_size;
+  bitmap_height = atlas_size;
+  bitmap.assign(bitmap_width * bitmap_height, 0);
+  assert(bitmap.size());
+
+  GlyphPackRange ranges[] = {
+      {
+          .codepoint = 0x20, // space
+          .length = 1,
+      },
+      {
+          .codepoint = 0x25A0, // black square
+          .length = 1,
+      },
+      {
+          .codepoint = 33,
+          .length = 95,
+      },
+  };
+  glyphs.clear();
+  codepoint_map.clear();
+  Pack(bitmap.data(), bitmap_width, bitmap_height, &font, ranges);
+  glyphs[0].offset.expand = 1;
+  return true;
+}
+
 void FontAtlas::Pack(uint8_t *atlas_bitmap, int atlas_width, int atlas_height,
                      const FontLoader *font, std::span<GlyphPackRange> ranges) {
+  TRACE_SCOPE("FontAtlas::Pack");
 
   std::vector<std::vector<stbtt_packedchar>> tmp_buffer;
   for (auto &range : ranges) {
@@ -78,6 +120,8 @@ void FontAtlas::Pack(uint8_t *atlas_bitmap, int atlas_width, int atlas_height,
   for (auto &stb_range : stb_ranges) {
     for (size_t i = 0; i < stb_range.num_chars; ++i) {
       auto &g = stb_range.chardata_for_range[i];
+      auto codepoint =
+          static_cast<uint32_t>(stb_range.first_unicode_codepoint_in_range + i);
       auto index = glyphs.size();
       glyphs.push_back({
           .xywh = {(float)g.x0, (float)g.y0, (float)g.x1, (float)g.y1},
@@ -86,11 +130,10 @@ void FontAtlas::Pack(uint8_t *atlas_bitmap, int atlas_width, int atlas_height,
                   .xoff = (float)g.xoff, .yoff = (float)g.yoff,
                   // (float)g.xoff2,
                   // (float)g.yoff2
+                  .doublewidth = CodepointWidth(codepoint) == 2 ? 1.0f : 0.0f,
               },
       });
-      codepoint_map.insert(std::make_pair(
-          static_cast<uint32_t>(stb_range.first_unicode_codepoint_in_range + i),
-          index));
+      codepoint_map.insert(std::make_pair(codepoint, index));
     }
   }
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "celltypes.h"
 #include <memory>
 #include <span>
 #include <stdint.h>
@@ -48,9 +49,15 @@ struct FontAtlas {
   std::vector<Glyph> glyphs;
   FontInfo info;
   std::unordered_map<uint32_t, size_t> codepoint_map;
+  // coverage. GL_RED texture or source of the cpu rasterizer
+  std::vector<uint8_t> bitmap;
+  uint32_t bitmap_width = 0;
+  uint32_t bitmap_height = 0;
 
 public:
-  size_t GlyphIndexFromCodePoint(std::span<const uint32_t> codepoints);
+  // load and pack the glyphs used by the terminal
+  bool Load(std::string_view path, PixelSize cell_size, uint32_t atlas_size);
+  size_t GlyphIndexFromCodePoint(std::span<const uint32_t> codepoints) const;
   void Pack(uint8_t *atlas_bitmap, int atlas_width, int atlas_height,
             const FontLoader *font, std::span<GlyphPackRange> ranges);
 };
@@ -0,0 +1,100 @@
+#include "frame_stats.h"
+#include <algorithm>
+#include <math.h>
+
+const char *FrameStageName(FrameStage stage) {
+  switch (stage) {
+  case FrameStage::PtyDrain:
+    return "pty drain";
+  case FrameStage::Parse:
+    return "parse";
+  case FrameStage::DamageWalk:
+    return "damage walk";
+  case FrameStage::CellConvert:
+    return "cell convert";
+  case FrameStage::BufferUpload:
+    return "buffer upload";
+  case FrameStage::UboUpload:
+    return "ubo upload";
+  case FrameStage::Draw:
+    return "draw";
+  case FrameStage::Frame:
+    return "frame";
+  case FrameStage::KeyToPresent:
+    return "key to present";
+  default:
+    return "";
+  }
+}
+
+void FrameStats::Series::Push(float ms) {
+  samples[head] = ms;
+  head = (head + 1) % FRAMES;
+  count = std::min(count + 1, FRAMES);
+}
+
+size_t FrameStats::Series::CopyTo(std::span<float> out) const {
+  auto n = std::min(count, out.size());
+  // skip the oldest that do not fit
+  auto first = head + FRAMES - n;
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = samples[(first + i) % FRAMES];
+  }
+  return n;
+}
+
+void FrameStats::Add(FrameStage stage, std::chrono::nanoseconds elapsed) {
+  current_[static_cast<size_t>(stage)] +=
+      std::chrono::duration<float, std::milli>(elapsed).count();
+}
+
+void FrameStats::EndFrame() {
+  // stages after Frame are pushed by AddSample
+  for (size_t i = 0; i <= static_cast<size_t>(FrameStage::Frame); ++i) {
+    cpu_[i].Push(current_[i]);
+    current_[i] = 0;
+  }
+  ++frames_;
+}
+
+void FrameStats::AddGpu(FrameStage stage, std::chrono::nanoseconds elapsed) {
+  gpu_[static_cast<size_t>(stage)].Push(
+      std::chrono::duration<float, std::milli>(elapsed).count());
+}
+
+void FrameStats::DropGpu(FrameStage stage) {
+  ++gpu_dropped_[static_cast<size_t>(stage)];
+}
+
+void FrameStats::AddSample(FrameStage stage,
+                           std::chrono::nanoseconds elapsed) {
+  cpu_[static_cast<size_t>(stage)].Push(
+      std::chrono::duration<float, std::milli>(elapsed).count());
+}
+
+StagePercentiles FrameStats::Percentiles(FrameStage stage, bool gpu) const {
+  float sorted[FRAMES];
+  auto &series = (gpu ? gpu_ : cpu_)[static_cast<size_t>(stage)];
+  auto n = series.CopyTo(sorted);
+  if (!n) {
+    return {};
+  }
+  std::sort(sorted, sorted + n);
+  // nearest rank
+  auto rank = [&](float p) {
+    auto i = static_cast<size_t>(ceilf(p * n));
+    return sorted[std::clamp<size_t>(i, 1, n) - 1];
+  };
+  return {
+      .p50 = rank(0.50f),
+      .p95 = rank(0.95f),
+      .p99 = rank(0.99f),
+      .max = sorted[n - 1],
+      .samples = n,
+  };
+}
+
+size_t FrameStats::Samples(FrameStage stage, bool gpu,
+                           std::span<float> out) const {
+  return (gpu ? gpu_ : cpu_)[static_cast<size_t>(stage)].CopyTo(out);
+}
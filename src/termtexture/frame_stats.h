@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+
+enum class FrameStage {
+  PtyDrain,
+  Parse,
+  DamageWalk,
+  CellConvert,
+  BufferUpload,
+  UboUpload,
+  Draw,
+  // whole TermTexture::Render
+  Frame,
+  // per echoed key, not per frame. see TermTexture::Presented
+  KeyToPresent,
+  Count,
+};
+const char *FrameStageName(FrameStage stage);
+
+// milliseconds
+struct StagePercentiles {
+  float p50 = 0;
+  float p95 = 0;
+  float p99 = 0;
+  float max = 0;
+  size_t samples = 0;
+};
+
+/// Rolling per-stage timings of the last FRAMES frames.
+/// CPU time is summed up per frame until EndFrame. GPU time is read back a
+/// few frames late by the backend and pushed per query.
+class FrameStats {
+public:
+  static constexpr size_t FRAMES = 240;
+
+private:
+  struct Series {
+    float samples[FRAMES] = {};
+    size_t head = 0;
+    size_t count = 0;
+    void Push(float ms);
+    // oldest first
+    size_t CopyTo(std::span<float> out) const;
+  };
+  Series cpu_[static_cast<size_t>(FrameStage::Count)];
+  Series gpu_[static_cast<size_t>(FrameStage::Count)];
+  float current_[static_cast<size_t>(FrameStage::Count)] = {};
+  uint64_t gpu_dropped_[static_cast<size_t>(FrameStage::Count)] = {};
+  uint64_t frames_ = 0;
+
+public:
+  uint64_t Frames() const { return frames_; }
+  void Add(FrameStage stage, std::chrono::nanoseconds elapsed);
+  void EndFrame();
+  void AddGpu(FrameStage stage, std::chrono::nanoseconds elapsed);
+  // a GPU sample that was not taken. all timer queries were in flight
+  void DropGpu(FrameStage stage);
+  uint64_t GpuDropped(FrameStage stage) const {
+    return gpu_dropped_[static_cast<size_t>(stage)];
+  }
+  // a sample of a stage that is not per frame
+  void AddSample(FrameStage stage, std::chrono::nanoseconds elapsed);
+  StagePercentiles Percentiles(FrameStage stage, bool gpu = false) const;
+  // oldest first. returns the copied count
+  size_t Samples(FrameStage stage, bool gpu, std::span<float> out) const;
+};
+
+/// Adds the lifetime to a stage.
+class ScopedStageTimer {
+  FrameStats *stats_;
+  FrameStage stage_;
+  std::chrono::steady_clock::time_point start_;
+
+public:
+  ScopedStageTimer(FrameStats *stats, FrameStage stage)
+      : stats_(stats), stage_(stage),
+        start_(stats ? std::chrono::steady_clock::now()
+                     : std::chrono::steady_clock::time_point{}) {}
+  ~ScopedStageTimer() {
+    if (stats_) {
+      stats_->Add(stage_, std::chrono::steady_clock::now() - start_);
+    }
+  }
+  ScopedStageTimer(const ScopedStageTimer &) = delete;
+  ScopedStageTimer &operator=(const ScopedStageTimer &) = delete;
+};
@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""Generates unicode_tables.h, two-stage lookup tables of the terminal width
+and the grapheme cluster break property of every codepoint.
+
+usage: gen_unicode_tables.py OUTPUT
+
+General categories and East Asian widths come from the unicodedata module of
+the Python that runs the build. The properties it does not have are listed
+below, from Unicode 14.0. Both must be the same version, so the script
+refuses any other unicodedata. Python 3.11 has Unicode 14.0.
+"""
+import sys
+import unicodedata
+
+UNICODE_VERSION = "14.0.0"
+
+# GraphemeBreakProperty.txt. Prepend
+PREPEND = [
+    (0x0600, 0x0605), (0x06DD, 0x06DD), (0x070F, 0x070F),
+    (0x0890, 0x0891), (0x08E2, 0x08E2), (0x0D4E, 0x0D4E),
+    (0x110BD, 0x110BD), (0x110CD, 0x110CD), (0x111C2, 0x111C3),
+    (0x1193F, 0x1193F), (0x11941, 0x11941), (0x11A3A, 0x11A3A),
+    (0x11A84, 0x11A89), (0x11D46, 0x11D46),
+]
+
+# Extend that is not Mn or Me. Other_Grapheme_Extend, Emoji_Modifier
+EXTEND = [
+    (0x09BE, 0x09BE), (0x09D7, 0x09D7), (0x0B3E, 0x0B3E),
+    (0x0B57, 0x0B57), (0x0BBE, 0x0BBE), (0x0BD7, 0x0BD7),
+    (0x0CC2, 0x0CC2), (0x0CD5, 0x0CD6), (0x0D3E, 0x0D3E),
+    (0x0D57, 0x0D57), (0x0DCF, 0x0DCF), (0x0DDF, 0x0DDF),
+    (0x1B35, 0x1B35), (0x200C, 0x200C), (0x302E, 0x302F),
+    (0xFF9E, 0xFF9F), (0x1133E, 0x1133E), (0x11357, 0x11357),
+    (0x114B0, 0x114B0), (0x114BD, 0x114BD), (0x115AF, 0x115AF),
+    (0x11930, 0x11930), (0x1D165, 0x1D165), (0x1D16E, 0x1D172),
+    (0x1F3FB, 0x1F3FF), (0xE0020, 0xE007F),
+]
+
+EXTENDED_PICTOGRAPHIC = [
+    (0x00A9, 0x00A9), (0x00AE, 0x00AE), (0x203C, 0x203C),
+    (0x2049, 0x2049), (0x2122, 0x2122), (0x2139, 0x2139),
+    (0x2194, 0x2199), (0x21A9, 0x21AA), (0x231A, 0x231B),
+    (0x2328, 0x2328), (0x2388, 0x2388), (0x23CF, 0x23CF),
+    (0x23E9, 0x23F3), (0x23F8, 0x23FA), (0x24C2, 0x24C2),
+    (0x25AA, 0x25AB), (0x25B6, 0x25B6), (0x25C0, 0x25C0),
+    (0x25FB, 0x25FE), (0x2600, 0x2605), (0x2607, 0x2612),
+    (0x2614, 0x2685), (0x2690, 0x2705), (0x2708, 0x2712),
+    (0x2714, 0x2714), (0x2716, 0x2716), (0x271D, 0x271D),
+    (0x2721, 0x2721), (0x2728, 0x2728), (0x2733, 0x2734),
+    (0x2744, 0x2744), (0x2747, 0x2747), (0x274C, 0x274C),
+    (0x274E, 0x274E), (0x2753, 0x2755), (0x2757, 0x2757),
+    (0x2763, 0x2767), (0x2795, 0x2797), (0x27A1, 0x27A1),
+    (0x27B0, 0x27B0), (0x27BF, 0x27BF), (0x2934, 0x2935),
+    (0x2B05, 0x2B07), (0x2B1B, 0x2B1C), (0x2B50, 0x2B50),
+    (0x2B55, 0x2B55), (0x3030, 0x3030), (0x303D, 0x303D),
+    (0x3297, 0x3297), (0x3299, 0x3299), (0x1F000, 0x1F0FF),
+    (0x1F10D, 0x1F10F), (0x1F12F, 0x1F12F), (0x1F16C, 0x1F171),
+    (0x1F17E, 0x1F17F), (0x1F18E, 0x1F18E), (0x1F191, 0x1F19A),
+    (0x1F1AD, 0x1F1E5), (0x1F201, 0x1F20F), (0x1F21A, 0x1F21A),
+    (0x1F22F, 0x1F22F), (0x1F232, 0x1F23A), (0x1F23C, 0x1F23F),
+    (0x1F249, 0x1F3FA), (0x1F400, 0x1F53D), (0x1F546, 0x1F64F),
+    (0x1F680, 0x1F6FF), (0x1F774, 0x1F77F), (0x1F7D5, 0x1F7FF),
+    (0x1F80C, 0x1F80F), (0x1F848, 0x1F84F), (0x1F85A, 0x1F85F),
+    (0x1F888, 0x1F88F), (0x1F8AE, 0x1F8FF), (0x1F90C, 0x1F93A),
+    (0x1F93C, 0x1F945), (0x1F947, 0x1FAFF), (0x1FC00, 0x1FFFD),
+]
+
+# Cn with Default_Ignorable_Code_Point. Control
+UNASSIGNED_IGNORABLE = [
+    (0x2065, 0x2065), (0xFFF0, 0xFFF8), (0xE0000, 0xE0000),
+    (0xE0002, 0xE001F), (0xE0080, 0xE00FF), (0xE01F0, 0xE0FFF),
+]
+
+# Prepended_Concatenation_Mark. Cf but not Control
+CONCATENATION_MARK = [
+    (0x0600, 0x0605), (0x06DD, 0x06DD), (0x070F, 0x070F),
+    (0x0890, 0x0891), (0x08E2, 0x08E2), (0x110BD, 0x110BD),
+    (0x110CD, 0x110CD),
+]
+
+# Mc that are not SpacingMark, and two Lo that are
+NOT_SPACING_MARK = [
+    (0x102B, 0x102C), (0x1038, 0x1038), (0x1062, 0x1064),
+    (0x1067, 0x106D), (0x1083, 0x1083), (0x1087, 0x108C),
+    (0x108F, 0x108F), (0x109A, 0x109C), (0x1A61, 0x1A61),
+    (0x1A63, 0x1A64), (0xAA7B, 0xAA7B), (0xAA7D, 0xAA7D),
+    (0x11720, 0x11721),
+]
+SPACING_MARK = [(0x0E33, 0x0E33), (0x0EB3, 0x0EB3)]
+
+# the order of enum class GraphemeBreak
+(GB_OTHER, GB_CR, GB_LF, GB_CONTROL, GB_EXTEND, GB_ZWJ, GB_REGIONAL_INDICATOR,
+ GB_PREPEND, GB_SPACING_MARK, GB_L, GB_V, GB_T, GB_LV, GB_LVT,
+ GB_PICTOGRAPHIC) = range(15)
+
+MAX_CODEPOINT = 0x10FFFF
+
+
+def in_ranges(ranges):
+    table = bytearray(MAX_CODEPOINT + 1)
+    for first, last in ranges:
+        table[first:last + 1] = b"\x01" * (last - first + 1)
+    return table
+
+
+def grapheme_breaks():
+    prepend = in_ranges(PREPEND)
+    extend = in_ranges(EXTEND)
+    pictographic = in_ranges(EXTENDED_PICTOGRAPHIC)
+    ignorable = in_ranges(UNASSIGNED_IGNORABLE)
+    concatenation = in_ranges(CONCATENATION_MARK)
+    not_spacing = in_ranges(NOT_SPACING_MARK)
+    spacing = in_ranges(SPACING_MARK)
+
+    values = bytearray(MAX_CODEPOINT + 1)
+    for cp in range(MAX_CODEPOINT + 1):
+        c = chr(cp)
+        gc = unicodedata.category(c)
+        if cp == 0x0D:
+            v = GB_CR
+        elif cp == 0x0A:
+            v = GB_LF
+        elif cp == 0x200D:
+            v = GB_ZWJ
+        elif prepend[cp]:
+            v = GB_PREPEND
+        elif gc in ("Mn", "Me") or extend[cp]:
+            v = GB_EXTEND
+        elif (gc in ("Cc", "Cs", "Zl", "Zp") or
+              (gc == "Cf" and not concatenation[cp]) or
+              (gc == "Cn" and ignorable[cp])):
+            v = GB_CONTROL
+        elif 0x1F1E6 <= cp <= 0x1F1FF:
+            v = GB_REGIONAL_INDICATOR
+        elif (gc == "Mc" and not not_spacing[cp]) or spacing[cp]:
+            v = GB_SPACING_MARK
+        elif 0x1100 <= cp <= 0x115F or 0xA960 <= cp <= 0xA97C:
+            v = GB_L
+        elif 0x1160 <= cp <= 0x11A7 or 0xD7B0 <= cp <= 0xD7C6:
+            v = GB_V
+        elif 0x11A8 <= cp <= 0x11FF or 0xD7CB <= cp <= 0xD7FB:
+            v = GB_T
+        elif 0xAC00 <= cp <= 0xD7A3:
+            v = GB_LV if (cp - 0xAC00) % 28 == 0 else GB_LVT
+        elif pictographic[cp]:
+            v = GB_PICTOGRAPHIC
+        else:
+            v = GB_OTHER
+        values[cp] = v
+    return values
+
+
+def widths():
+    values = bytearray(MAX_CODEPOINT + 1)
+    for cp in range(MAX_CODEPOINT + 1):
+        c = chr(cp)
+        gc = unicodedata.category(c)
+        if cp == 0xAD:
+            # soft hyphen is shown
+            w = 1
+        elif (gc in ("Mn", "Me", "Cf", "Cc", "Zl", "Zp") or
+              0x1160 <= cp <= 0x11FF or 0xD7B0 <= cp <= 0xD7FF):
+            # combining, format and control. Hangul medial vowels and final
+            # consonants join the syllable
+            w = 0
+        elif unicodedata.east_asian_width(c) in ("W", "F"):
+            w = 2
+        elif gc == "Cn" and (0x20000 <= cp <= 0x2FFFD or
+                             0x30000 <= cp <= 0x3FFFD):
+            # unassigned ideographs default to wide
+            w = 2
+        else:
+            w = 1
+        values[cp] = w
+    return values
+
+
+def split(values, shift):
+    """stage1[cp >> shift] is a block of stage2. same blocks are shared"""
+    size = 1 << shift
+    blocks = {}
+    stage1 = []
+    stage2 = bytearray()
+    for start in range(0, len(values), size):
+        block = bytes(values[start:start + size])
+        if block not in blocks:
+            blocks[block] = len(blocks)
+            stage2 += block
+        stage1.append(blocks[block])
+    return stage1, stage2
+
+
+def c_array(type_name, name, values):
+    lines = []
+    line = "   "
+    for v in values:
+        item = " %d," % v
+        if len(line) + len(item) > 80:
+            lines.append(line)
+            line = "   "
+        line += item
+    lines.append(line)
+    return "inline constexpr %s %s[] = {\n%s\n};\n" % (
+        type_name, name, "\n".join(lines))
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__)
+        return 1
+    if unicodedata.unidata_version != UNICODE_VERSION:
+        # a newer category or width would not match the lists below
+        print("gen_unicode_tables.py: unicodedata is Unicode %s, the lists "
+              "are Unicode %s. run it with Python 3.11" %
+              (unicodedata.unidata_version, UNICODE_VERSION),
+              file=sys.stderr)
+        return 1
+    breaks = grapheme_breaks()
+    width = widths()
+    # one byte. the break in the low bits, the width above
+    values = bytearray(b | w << 4 for b, w in zip(breaks, width))
+
+    best = None
+    for shift in range(4, 11):
+        stage1, stage2 = split(values, shift)
+        stage1_size = len(stage1) * (1 if max(stage1) < 256 else 2)
+        size = stage1_size + len(stage2)
+        if not best or size < best[0]:
+            best = (size, shift, stage1, stage2)
+    size, shift, stage1, stage2 = best
+    stage1_type = "uint8_t" if max(stage1) < 256 else "uint16_t"
+
+    with open(sys.argv[1], "w", newline="\n") as f:
+        f.write("// generated by gen_unicode_tables.py from Unicode %s.\n"
+                % unicodedata.unidata_version)
+        f.write("// %d bytes. do not edit\n" % size)
+        f.write("#pragma once\n#include <stdint.h>\n\n")
+        f.write("namespace unicode_tables {\n\n")
+        f.write("inline constexpr uint32_t SHIFT = %d;\n" % shift)
+        f.write(c_array(stage1_type, "STAGE1", stage1))
+        f.write(c_array("uint8_t", "STAGE2", stage2))
+        f.write("\n} // namespace unicode_tables\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
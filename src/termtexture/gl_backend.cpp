@@ -0,0 +1,593 @@
+#include "gl_backend.h"
+#include "gl_render_context_impl.h"
+#include "fontatlas.h"
+#include "frame_stats.h"
+#include <gl/glew.h>
+#include <glo/scoped_binder.h>
+#include <glo/shader.h>
+#include <glo/state_cache.h>
+#include <glo/texture.h>
+#include <glo/timer_query.h>
+#include <glo/ubo.h>
+#include <glo/vao.h>
+#include <memory>
+#include <optional>
+#include <plog/Log.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+auto vs_src = R"(#version 450
+layout(location = 0) in vec3 i_Pos;
+layout(location = 1) in vec4 i_Color;
+layout(location = 2) in vec4 i_BgColor;
+layout(location = 0) out vData { 
+  vec4 color; 
+  vec4 bgColor;
+}
+vertex;
+void main() {
+  gl_Position = vec4(i_Pos, 1);
+  vertex.color = i_Color;
+  vertex.bgColor = i_BgColor;
+}
+)";
+
+auto gs_src = R"(#version 450 core
+layout(points) in;
+layout(triangle_strip, max_vertices = 10) out;
+
+// specialization constants. see CellConstant
+layout(constant_id = 0) const int FILL_GLYPH = 1;
+layout(constant_id = 1) const float FILL_INSET = 2;
+// false for a frame without history. the ring lookup folds away
+layout(constant_id = 2) const bool SCROLLED = true;
+
+layout(std140, binding = 0) uniform Global {
+  mat4 projection;
+  vec2 screenSize;
+  vec2 cellSize;
+  vec2 atlasSize;
+  float ascent;
+  float descent;
+  // rows scrolled back into history. fractional for smooth scroll
+  float scrollRows;
+  // history ring size and the slot of the line scrolled to the top
+  float historyRows;
+  float historyAnchor;
+  float padding;
+}
+global;
+
+struct Glyph {
+  vec4 xywh;
+  vec4 offset;
+};
+
+layout(std140, binding = 1) uniform Glyphs { Glyph glyphs[128]; };
+
+layout(location = 0) in vData { 
+  vec4 color; 
+  vec4 bgColor;
+}
+vertices[];
+layout(location = 0) out vec2 g_TexCoords;
+layout(location = 1) out vec4 g_Color;
+
+vec2 pixelToUv(float x, float y) {
+  return vec2((x + 0.5) / global.atlasSize.x, (y + 0.5) / global.atlasSize.y);
+}
+
+// -1+1 +1+1
+//  0+----+2
+//   |   /|
+//   |  / |
+//   | /  |
+//   |/   |
+//  1+----+3
+// -1-1 +1-1
+void main() {
+  vec2 cellSize = global.cellSize;
+  vec2 pos = gl_in[0].gl_Position.xy;
+  if (!SCROLLED) {
+    // screen rows only
+  } else if (pos.y < 0) {
+    // history ring slot is stored as -(slot + 1)
+    float slot = -pos.y - 1;
+    float rel = mod(slot - global.historyAnchor + global.historyRows,
+                    global.historyRows);
+    float lines = ceil(global.scrollRows);
+    if (rel >= lines) {
+      // below the history. screen rows are drawn there
+      return;
+    }
+    pos.y = rel - (lines - global.scrollRows);
+    if (pos.y > global.screenSize.y / cellSize.y) {
+      return;
+    }
+  } else {
+    pos.y += global.scrollRows;
+  }
+  vec2 topLeft = pos * cellSize;
+  int glyphIndex = int(gl_in[0].gl_Position.z);
+  Glyph glyph = glyphs[glyphIndex];
+  float l = glyph.xywh.x;
+  float t = glyph.xywh.y;
+  float r = glyph.xywh.z;
+  float b = glyph.xywh.w;
+
+  float w = r - l;
+  float h = b - t;
+  vec2 glyph_offset = vec2(glyph.offset.x, glyph.offset.y + global.ascent);
+  vec4 cell_0 = vec4(topLeft + glyph_offset + vec2(0, 0), 0, 1);
+  vec4 cell_1 = vec4(topLeft + glyph_offset + vec2(0, h), 0, 1);
+  vec4 cell_2 = vec4(topLeft + glyph_offset + vec2(w, 0), 0, 1);
+  vec4 cell_3 = vec4(topLeft + glyph_offset + vec2(w, h), 0, 1);
+
+  vec4 expand_0 = vec4(topLeft + vec2(0, 0), -0.1, 1);
+  vec4 expand_1 = vec4(topLeft + vec2(0, cellSize.y), -0.1, 1);
+  vec4 expand_2 = vec4(topLeft + vec2(cellSize.x, 0), -0.1, 1);
+  vec4 expand_3 = vec4(topLeft + vec2(cellSize.x, cellSize.y), -0.1, 1);
+
+  //
+  Glyph fill_glyph = glyphs[FILL_GLYPH];
+  float fl = fill_glyph.xywh.x + FILL_INSET;
+  float ft = fill_glyph.xywh.y + FILL_INSET;
+  float fr = fill_glyph.xywh.z - FILL_INSET;
+  float fb = fill_glyph.xywh.w - FILL_INSET;
+
+  // 0
+  gl_Position = global.projection * expand_0;
+  g_TexCoords = pixelToUv(fl, ft);
+  g_Color = vertices[0].bgColor;
+  EmitVertex();
+
+  // 1
+  gl_Position = global.projection * expand_1;
+  g_TexCoords = pixelToUv(fl, fb);
+  g_Color = vertices[0].bgColor;
+  EmitVertex();
+
+  // 2
+  gl_Position = global.projection * expand_2;
+  g_TexCoords = pixelToUv(fr, ft);
+  g_Color = vertices[0].bgColor;
+  EmitVertex();
+
+  // 3
+  gl_Position = global.projection * expand_3;
+  g_TexCoords = pixelToUv(fr, fb);
+  g_Color = vertices[0].bgColor;
+  EmitVertex();
+
+  // 3 dummy
+  gl_Position = global.projection * expand_3;
+  EmitVertex();
+
+  // 0 dummy
+  gl_Position = global.projection * cell_0;
+  EmitVertex();
+
+  // 0
+  gl_Position = global.projection * cell_0;
+  g_TexCoords = pixelToUv(l, t);
+  g_Color = vertices[0].color;
+  EmitVertex();
+
+  // 1
+  gl_Position = global.projection * cell_1;
+  g_TexCoords = pixelToUv(l, b);
+  g_Color = vertices[0].color;
+  EmitVertex();
+
+  // 2
+  gl_Position = global.projection * cell_2;
+  g_TexCoords = pixelToUv(r, t);
+  g_Color = vertices[0].color;
+  EmitVertex();
+
+  // 3
+  gl_Position = global.projection * cell_3;
+  g_TexCoords = pixelToUv(r, b);
+  g_Color = vertices[0].color;
+  EmitVertex();
+
+  EndPrimitive();
+}
+)";
+
+auto fs_src = R"(#version 460 core
+
+layout(location = 0) in vec2 g_TexCoords;
+layout(location = 1) in vec4 g_Color;
+layout(location = 0) out vec4 FragColor;
+layout(binding = 0) uniform sampler2D uTex;
+
+void main() {
+  vec4 texcel = texture(uTex, g_TexCoords);
+  FragColor = vec4(g_Color.rgb, texcel.x);
+  // FragColor = vec4(TexCoords, 0, 1);
+}
+)";
+
+auto cursor_vs_src = R"(#version 450
+layout (location = 0) in vec2 vPos;
+void main()
+{
+    gl_Position = vec4(vPos, 0.0, 1.0);
+}
+)";
+
+auto cursor_fs_src = R"(#version 450
+layout (location = 0) out vec4 uFragColor;
+void main()
+{
+    uFragColor = vec4(1, 1, 1, 1);
+}
+)";
+
+// constant_id of gs_src
+enum CellConstant : uint32_t {
+  CELL_FILL_GLYPH,
+  CELL_FILL_INSET,
+  CELL_SCROLLED,
+};
+
+static uint32_t FloatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static std::shared_ptr<glo::ShaderProgram> CreateCellProgram(bool scrolled) {
+  // the fill glyph is the second glyph of the atlas. inset against bleeding
+  glo::SpecializationConstant constants[] = {
+      {CELL_FILL_GLYPH, 1},
+      {CELL_FILL_INSET, FloatBits(2.0f)},
+      {CELL_SCROLLED, scrolled},
+  };
+  glo::ShaderSources src{vs_src, fs_src, gs_src};
+  src.gs_constants = constants;
+  return glo::ShaderProgram::Create(src);
+}
+
+bool GlRenderContextImpl::Initialize() {
+  shader = CreateCellProgram(true);
+  if (!shader) {
+    return false;
+  }
+  screen_shader = CreateCellProgram(false);
+  if (!screen_shader) {
+    return false;
+  }
+  cursor_shader = glo::ShaderProgram::Create({cursor_vs_src, cursor_fs_src});
+  if (!cursor_shader) {
+    return false;
+  }
+  uniforms = glo::UniformRing::Create();
+  uploader = glo::TextureUploader::Create();
+  return true;
+}
+
+// cpu time and a timer query around a stage
+class ScopedGpuStage {
+  ScopedStageTimer cpu_;
+  glo::TimerQuery *query_;
+
+public:
+  ScopedGpuStage(FrameStats *stats, FrameStage stage, glo::TimerQuery *query)
+      : cpu_(stats, stage), query_(nullptr) {
+    if (!stats || !query) {
+      return;
+    }
+    if (query->Begin()) {
+      query_ = query;
+    } else {
+      stats->DropGpu(stage);
+    }
+  }
+  ~ScopedGpuStage() {
+    if (query_) {
+      query_->End();
+    }
+  }
+  ScopedGpuStage(const ScopedGpuStage &) = delete;
+  ScopedGpuStage &operator=(const ScopedGpuStage &) = delete;
+};
+
+const FrameStage GPU_STAGES[] = {
+    FrameStage::BufferUpload,
+    FrameStage::UboUpload,
+    FrameStage::Draw,
+};
+
+class GlBackendImpl {
+  std::shared_ptr<glo::VAO> vao_;
+  int draw_count_ = 0;
+  int history_cols_ = 0;
+  std::shared_ptr<glo::VAO> history_vao_;
+  HistoryRange history_ranges_[2] = {};
+  glo::TypedUBO<Global> ubo_global_;
+  // ubo_global_ in the shared ring and the contents pushed there
+  glo::UniformRange global_range_;
+  std::optional<Global> pushed_global_;
+  // programs, atlas texture and glyph table are shared
+  std::shared_ptr<GlRenderContext> context_;
+  std::shared_ptr<GlFont> font_;
+
+  std::shared_ptr<glo::VBO> cursor_vbo_;
+  std::shared_ptr<glo::VAO> cursor_vao_;
+
+  FrameStats *stats_ = nullptr;
+  // per GPU_STAGES
+  std::shared_ptr<glo::TimerQuery> queries_[std::size(GPU_STAGES)];
+
+  glo::TimerQuery *Query(FrameStage stage) {
+    for (size_t i = 0; i < std::size(GPU_STAGES); ++i) {
+      if (GPU_STAGES[i] == stage) {
+        return queries_[i].get();
+      }
+    }
+    return nullptr;
+  }
+
+  // results of earlier frames. never waits
+  void PollQueries() {
+    for (size_t i = 0; i < std::size(GPU_STAGES); ++i) {
+      std::chrono::nanoseconds elapsed;
+      while (queries_[i] && queries_[i]->TryGet(&elapsed)) {
+        if (stats_) {
+          stats_->AddGpu(GPU_STAGES[i], elapsed);
+        }
+      }
+    }
+  }
+
+public:
+  void SetStats(FrameStats *stats) {
+    stats_ = stats;
+    if (stats_ && !queries_[0]) {
+      for (auto &query : queries_) {
+        query = glo::TimerQuery::Create();
+      }
+    }
+  }
+
+  bool Initialize(const std::shared_ptr<GlRenderContext> &context) {
+    context_ = context ? context : GlRenderContext::Create();
+    if (!context_) {
+      return false;
+    }
+
+    ubo_global_.Initialize();
+
+    // vertex buffer
+    auto vbo = glo::VBO::Create();
+    glo::VertexLayout layouts[] = {
+        {{"i_Pos", 0}, GL_FLOAT, 3, 20, 0},
+        {{"i_Color", 1}, GL_UNSIGNED_BYTE, 4, 20, 12},
+        {{"i_BgColor", 2}, GL_UNSIGNED_BYTE, 4, 20, 16},
+    };
+    vao_ = glo::VAO::Create(vbo, layouts);
+    history_vao_ = glo::VAO::Create(glo::VBO::Create(), layouts);
+
+    // cursor
+    cursor_vbo_ = glo::VBO::Create();
+    glo::VertexLayout cursor_layouts[] = {
+        {{"vPos", 0}, GL_FLOAT, 2, 8, 0},
+    };
+    cursor_vbo_->SetData(8 * 4, nullptr, true);
+    cursor_vao_ = glo::VAO::Create(cursor_vbo_, cursor_layouts);
+
+    return true;
+  }
+
+  bool LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas) {
+    font_ = context_->impl_->Font(atlas);
+    if (!font_) {
+      return false;
+    }
+
+    // ubo_global
+    ubo_global_.buffer.atlasSize[0] = (float)atlas->bitmap_width;
+    ubo_global_.buffer.atlasSize[1] = (float)atlas->bitmap_height;
+    ubo_global_.buffer.ascent = atlas->info.ascents;
+    ubo_global_.buffer.descent = atlas->info.descents;
+
+    return true;
+  }
+
+  void UpdateCells(std::span<const CellVertex> cells) {
+    ScopedGpuStage stage(stats_, FrameStage::BufferUpload,
+                         Query(FrameStage::BufferUpload));
+    vao_->GetVBO()->DataFromSpan(cells, true);
+    draw_count_ = static_cast<int>(cells.size());
+  }
+
+  void AllocateHistory(int rows, int cols) {
+    history_cols_ = cols;
+    history_vao_->GetVBO()->SetData(
+        static_cast<uint32_t>(rows * cols * sizeof(CellVertex)), nullptr,
+        true);
+  }
+
+  void UpdateHistoryRow(int slot, std::span<const CellVertex> cells) {
+    // a query per row would exhaust the ring
+    ScopedStageTimer stage(stats_, FrameStage::BufferUpload);
+    history_vao_->GetVBO()->SetSubData(
+        cells.data(),
+        static_cast<uint32_t>(slot * history_cols_ * sizeof(CellVertex)),
+        static_cast<uint32_t>(cells.size() * sizeof(CellVertex)));
+  }
+
+  void SetScroll(float scroll_rows, int history_rows, int anchor,
+                 std::span<const HistoryRange> ranges) {
+    ubo_global_.buffer.scrollRows = scroll_rows;
+    ubo_global_.buffer.historyRows = static_cast<float>(history_rows);
+    ubo_global_.buffer.historyAnchor = static_cast<float>(anchor);
+    for (size_t i = 0; i < std::size(history_ranges_); ++i) {
+      history_ranges_[i] = i < ranges.size() ? ranges[i] : HistoryRange{};
+    }
+  }
+
+  void Render(PixelSize screen_size, PixelSize cell_size,
+              std::chrono::nanoseconds duration) {
+    if (!font_) {
+      return;
+    }
+    PollQueries();
+    // posted last frame
+    context_->impl_->uploader->Flush();
+
+    {
+      // ubo_global
+      ScopedGpuStage stage(stats_, FrameStage::UboUpload,
+                           Query(FrameStage::UboUpload));
+      ubo_global_.buffer.cellSize[0] = (float)cell_size.width;
+      ubo_global_.buffer.cellSize[1] = (float)cell_size.height;
+      ubo_global_.buffer.screenSize[0] = (float)screen_size.width;
+      ubo_global_.buffer.screenSize[1] = (float)screen_size.height;
+      ubo_global_.buffer.UpdateProjection(screen_size, cell_size);
+      if (auto ring = context_->impl_->uniforms.get()) {
+        // only when it changed or the ring is about to reuse its range
+        if (!pushed_global_ || !ring->Live(global_range_) ||
+            memcmp(&*pushed_global_, &ubo_global_.buffer, sizeof(Global))) {
+          global_range_ = ring->Push(ubo_global_.buffer);
+          pushed_global_ = ubo_global_.buffer;
+        }
+      } else {
+        // only the changed bytes
+        ubo_global_.Upload();
+      }
+    }
+
+    {
+      ScopedGpuStage stage(stats_, FrameStage::Draw, Query(FrameStage::Draw));
+      bool scrolled = ubo_global_.buffer.scrollRows != 0;
+      for (auto &range : history_ranges_) {
+        scrolled = scrolled || range.count;
+      }
+      auto &shader = scrolled ? context_->impl_->shader
+                              : context_->impl_->screen_shader;
+      auto shader_scope = ScopedBind(shader);
+      auto texture_scope = ScopedBind(font_->texture);
+      auto &state = glo::StateCache::Current();
+      state.Enable(GL_BLEND);
+      state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      {
+        if (auto ring = context_->impl_->uniforms.get()) {
+          ring->Bind(0, global_range_);
+        } else {
+          shader->SetUBO(0, ubo_global_.Handle());
+        }
+        shader->SetUBO(1, font_->glyphs.Handle());
+        vao_->Draw(GL_POINTS, 0, draw_count_);
+        for (auto &range : history_ranges_) {
+          if (range.count) {
+            history_vao_->Draw(GL_POINTS, range.offset, range.count);
+          }
+        }
+      }
+    }
+  }
+
+  void RenderCursor(int left, int top, int right, int bottom,
+                    PixelSize screen_size) {
+    ScopedStageTimer stage(stats_, FrameStage::Draw);
+    // update
+    // 0 2
+    // 1 3
+    float l = -1 + 2 * (float)left / screen_size.width;
+    float r = -1 + 2 * (float)right / screen_size.width;
+    float t = 1 - 2 * (float)top / screen_size.height;
+    float b = 1 - 2 * (float)bottom / screen_size.height;
+    float vertices[8] = {
+        l, t, //
+        l, b, //
+        r, t, //
+        r, b, //
+    };
+    cursor_vbo_->SetSubData(vertices, 0, sizeof(vertices));
+    // render
+    auto shader_scope = ScopedBind(context_->impl_->cursor_shader);
+    auto &state = glo::StateCache::Current();
+    state.Enable(GL_BLEND);
+    state.BlendFunc(GL_ONE_MINUS_DST_COLOR, GL_ZERO);
+    cursor_vao_->Draw(GL_TRIANGLE_STRIP, 0, 4);
+  }
+};
+
+//
+// GlRenderContext
+//
+GlRenderContext::GlRenderContext() : impl_(new GlRenderContextImpl) {}
+
+GlRenderContext::~GlRenderContext() { delete impl_; }
+
+std::shared_ptr<GlRenderContext> GlRenderContext::Create() {
+  auto ptr = std::shared_ptr<GlRenderContext>(new GlRenderContext);
+  if (!ptr->impl_->Initialize()) {
+    return nullptr;
+  }
+  return ptr;
+}
+
+std::shared_ptr<const FontAtlas>
+GlRenderContext::LoadFont(std::string_view path, PixelSize cell_size,
+                          uint32_t atlas_size) {
+  return impl_->LoadFont(path, cell_size, atlas_size);
+}
+
+size_t GlRenderContext::FontCount() const { return impl_->FontCount(); }
+
+//
+// GlBackend
+//
+GlBackend::GlBackend() : impl_(new GlBackendImpl) {}
+
+GlBackend::~GlBackend() { delete impl_; }
+
+std::shared_ptr<GlBackend>
+GlBackend::Create(const std::shared_ptr<GlRenderContext> &context) {
+  auto ptr = std::shared_ptr<GlBackend>(new GlBackend);
+  if (!ptr->impl_->Initialize(context)) {
+    return nullptr;
+  }
+  return ptr;
+}
+
+void GlBackend::SetStats(FrameStats *stats) { impl_->SetStats(stats); }
+
+bool GlBackend::LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                          PixelSize cell_size) {
+  return impl_->LoadAtlas(atlas);
+}
+
+void GlBackend::UpdateCells(std::span<const CellVertex> cells,
+                            std::span<const uint32_t> changed) {
+  impl_->UpdateCells(cells);
+}
+
+void GlBackend::AllocateHistory(int rows, int cols) {
+  impl_->AllocateHistory(rows, cols);
+}
+
+void GlBackend::UpdateHistoryRow(int slot, std::span<const CellVertex> cells) {
+  impl_->UpdateHistoryRow(slot, cells);
+}
+
+void GlBackend::SetScroll(float scroll_rows, int history_rows, int anchor,
+                          std::span<const HistoryRange> ranges) {
+  impl_->SetScroll(scroll_rows, history_rows, anchor, ranges);
+}
+
+void GlBackend::Render(PixelSize screen_size, PixelSize cell_size,
+                       std::chrono::nanoseconds duration) {
+  impl_->Render(screen_size, cell_size, duration);
+}
+
+void GlBackend::RenderCursor(int left, int top, int right, int bottom,
+                             PixelSize screen_size) {
+  impl_->RenderCursor(left, top, right, bottom, screen_size);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "render_backend.h"
+#include <memory>
+#include <string_view>
+
+/// GL objects shared by terminals.
+/// The programs are compiled once, and terminals that load the same font
+/// and cell size share one atlas, one atlas texture and one glyph UBO.
+/// A font is released with its last terminal.
+/// Terminals must render on the GL context (or share group) that created it.
+class GlRenderContext {
+  class GlRenderContextImpl *impl_ = nullptr;
+  friend class GlBackendImpl;
+  friend class GlBatchImpl;
+
+  GlRenderContext();
+
+public:
+  ~GlRenderContext();
+  GlRenderContext(const GlRenderContext &) = delete;
+  GlRenderContext &operator=(const GlRenderContext &) = delete;
+  // nullptr if a shader fails. needs a current GL context
+  static std::shared_ptr<GlRenderContext> Create();
+  // rasterized once per path, cell size and atlas size. nullptr if it fails
+  std::shared_ptr<const FontAtlas> LoadFont(std::string_view path,
+                                            PixelSize cell_size,
+                                            uint32_t atlas_size);
+  // fonts that have GL objects alive
+  size_t FontCount() const;
+};
+
+/// OpenGL 4.x. one point per cell expanded by a geometry shader.
+class GlBackend : public RenderBackend {
+  class GlBackendImpl *impl_ = nullptr;
+
+  GlBackend();
+
+public:
+  ~GlBackend();
+  GlBackend(const GlBackend &) = delete;
+  GlBackend &operator=(const GlBackend &) = delete;
+  // nullptr if a shader fails. needs a current GL context.
+  // a private GlRenderContext is created if context is nullptr
+  static std::shared_ptr<GlBackend>
+  Create(const std::shared_ptr<GlRenderContext> &context = nullptr);
+  // GPU time by timer queries, read back a few frames late
+  void SetStats(FrameStats *stats) override;
+  bool LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                 PixelSize cell_size) override;
+  void UpdateCells(std::span<const CellVertex> cells,
+                   std::span<const uint32_t> changed) override;
+  void AllocateHistory(int rows, int cols) override;
+  void UpdateHistoryRow(int slot, std::span<const CellVertex> cells) override;
+  void SetScroll(float scroll_rows, int history_rows, int anchor,
+                 std::span<const HistoryRange> ranges) override;
+  void Render(PixelSize screen_size, PixelSize cell_size,
+              std::chrono::nanoseconds duration) override;
+  void RenderCursor(int left, int top, int right, int bottom,
+                    PixelSize screen_size) override;
+};
@@ -0,0 +1,498 @@
+#include "gl_batch.h"
+#include "fontatlas.h"
+#include "frame_stats.h"
+#include "gl_render_context_impl.h"
+#include <gl/glew.h>
+#include <glo/scoped_binder.h>
+#include <glo/state_cache.h>
+#include <glo/vao.h>
+#include <plog/Log.h>
+#include <string.h>
+#include <vector>
+
+auto batch_vs_src = R"(#version 430
+layout(location = 0) in vec3 i_Pos;
+layout(location = 1) in vec4 i_Color;
+layout(location = 2) in vec4 i_BgColor;
+// per instance. the base instance of the draw command
+layout(location = 3) in float i_Terminal;
+out vData {
+  vec4 color;
+  vec4 bgColor;
+  flat int terminal;
+}
+vertex;
+void main() {
+  gl_Position = vec4(i_Pos, 1);
+  vertex.color = i_Color;
+  vertex.bgColor = i_BgColor;
+  vertex.terminal = int(i_Terminal);
+}
+)";
+
+auto batch_gs_src = R"(#version 430 core
+layout(points) in;
+layout(triangle_strip, max_vertices = 8) out;
+
+layout(std140, binding = 0) uniform Global {
+  mat4 projection;
+  vec2 screenSize;
+  vec2 cellSize;
+  vec2 atlasSize;
+  float ascent;
+  float descent;
+  float scrollRows;
+  float historyRows;
+  float historyAnchor;
+  float padding;
+}
+global;
+
+struct Glyph {
+  vec4 xywh;
+  vec4 offset;
+};
+
+layout(std140, binding = 1) uniform Glyphs { Glyph glyphs[128]; };
+
+struct Terminal {
+  // left, top, width, height in the target
+  vec4 rect;
+  // left, top, right, bottom in the terminal
+  vec4 cursor;
+};
+
+layout(std140, binding = 2) uniform Terminals { Terminal terminals[256]; };
+
+in vData {
+  vec4 color;
+  vec4 bgColor;
+  flat int terminal;
+}
+vertices[];
+
+out gl_PerVertex {
+  vec4 gl_Position;
+  float gl_ClipDistance[4];
+};
+out vec2 g_TexCoords;
+out vec4 g_Color;
+// pixel in the terminal
+out vec2 g_Pixel;
+flat out vec4 g_Cursor;
+
+Terminal terminal;
+
+vec2 pixelToUv(float x, float y) {
+  return vec2((x + 0.5) / global.atlasSize.x, (y + 0.5) / global.atlasSize.y);
+}
+
+void emit(vec2 pixel, vec2 uv, vec4 color) {
+  gl_Position = global.projection * vec4(pixel, 0, 1);
+  // clip to the terminal rect
+  gl_ClipDistance[0] = pixel.x - terminal.rect.x;
+  gl_ClipDistance[1] = terminal.rect.x + terminal.rect.z - pixel.x;
+  gl_ClipDistance[2] = pixel.y - terminal.rect.y;
+  gl_ClipDistance[3] = terminal.rect.y + terminal.rect.w - pixel.y;
+  g_TexCoords = uv;
+  g_Color = color;
+  g_Pixel = pixel - terminal.rect.xy;
+  g_Cursor = terminal.cursor;
+  EmitVertex();
+}
+
+void main() {
+  terminal = terminals[vertices[0].terminal];
+  vec2 cellSize = global.cellSize;
+  vec2 topLeft = terminal.rect.xy + gl_in[0].gl_Position.xy * cellSize;
+  Glyph glyph = glyphs[int(gl_in[0].gl_Position.z)];
+  float l = glyph.xywh.x;
+  float t = glyph.xywh.y;
+  float r = glyph.xywh.z;
+  float b = glyph.xywh.w;
+  vec2 glyphTopLeft =
+      topLeft + vec2(glyph.offset.x, glyph.offset.y + global.ascent);
+
+  Glyph fill_glyph = glyphs[1];
+  float fl = fill_glyph.xywh.x + 2;
+  float ft = fill_glyph.xywh.y + 2;
+  float fr = fill_glyph.xywh.z - 2;
+  float fb = fill_glyph.xywh.w - 2;
+
+  // background
+  vec4 bg = vertices[0].bgColor;
+  emit(topLeft, pixelToUv(fl, ft), bg);
+  emit(topLeft + vec2(0, cellSize.y), pixelToUv(fl, fb), bg);
+  emit(topLeft + vec2(cellSize.x, 0), pixelToUv(fr, ft), bg);
+  emit(topLeft + cellSize, pixelToUv(fr, fb), bg);
+  EndPrimitive();
+
+  // glyph
+  vec4 fg = vertices[0].color;
+  emit(glyphTopLeft, pixelToUv(l, t), fg);
+  emit(glyphTopLeft + vec2(0, b - t), pixelToUv(l, b), fg);
+  emit(glyphTopLeft + vec2(r - l, 0), pixelToUv(r, t), fg);
+  emit(glyphTopLeft + vec2(r - l, b - t), pixelToUv(r, b), fg);
+  EndPrimitive();
+}
+)";
+
+auto batch_fs_src = R"(#version 430 core
+in vec2 g_TexCoords;
+in vec4 g_Color;
+in vec2 g_Pixel;
+flat in vec4 g_Cursor;
+layout(location = 0) out vec4 FragColor;
+uniform sampler2D uTex;
+
+void main() {
+  vec4 texcel = texture(uTex, g_TexCoords);
+  vec3 color = g_Color.rgb;
+  if (all(greaterThanEqual(g_Pixel, g_Cursor.xy)) &&
+      all(lessThan(g_Pixel, g_Cursor.zw))) {
+    // block cursor. inverting bg and fg inverts the blended result
+    color = 1 - color;
+  }
+  FragColor = vec4(color, texcel.x);
+}
+)";
+
+struct BatchTerminal {
+  float rect[4];
+  float cursor[4];
+};
+
+struct BatchTerminals {
+  BatchTerminal terminals[GlBatch::MAX_TERMINALS];
+};
+
+// GL_DRAW_INDIRECT_BUFFER
+struct DrawArraysIndirectCommand {
+  uint32_t count;
+  uint32_t instance_count;
+  uint32_t first;
+  uint32_t base_instance;
+};
+
+// the vertex buffer starts with the terminal index of each slot as a per
+// instance attribute, followed by the cells of all slots
+const uint32_t CELLS_OFFSET = GlBatch::MAX_TERMINALS * sizeof(float);
+
+struct BatchSlot {
+  bool used = false;
+  std::vector<CellVertex> cells;
+  // rows * cols. the cells grow up to it
+  uint32_t reserve = 0;
+  // in vertices after CELLS_OFFSET
+  uint32_t offset = 0;
+  uint32_t capacity = 0;
+  // changed cells not uploaded yet. clean if begin >= end
+  uint32_t dirty_begin = 0;
+  uint32_t dirty_end = 0;
+
+  void Dirty(uint32_t begin, uint32_t end) {
+    if (dirty_begin >= dirty_end) {
+      dirty_begin = begin;
+      dirty_end = end;
+    } else {
+      dirty_begin = std::min(dirty_begin, begin);
+      dirty_end = std::max(dirty_end, end);
+    }
+  }
+};
+
+class GlBatchImpl {
+  std::shared_ptr<GlRenderContext> context_;
+  std::shared_ptr<glo::ShaderProgram> shader_;
+  std::shared_ptr<GlFont> font_;
+  PixelSize cell_size_ = {};
+  glo::TypedUBO<Global> ubo_global_;
+  glo::TypedUBO<BatchTerminals> ubo_terminals_;
+  std::shared_ptr<glo::VAO> vao_;
+  uint32_t indirect_ = 0;
+  std::vector<DrawArraysIndirectCommand> commands_;
+  BatchSlot slots_[GlBatch::MAX_TERMINALS];
+  // a slot is added, removed or outgrows its capacity
+  bool relayout_ = true;
+
+public:
+  ~GlBatchImpl() {
+    if (indirect_) {
+      glo::StateCache::Current().DeleteBuffer(indirect_);
+    }
+  }
+
+  bool Initialize(const std::shared_ptr<GlRenderContext> &context) {
+    context_ = context;
+    shader_ = glo::ShaderProgram::Create(
+        {batch_vs_src, batch_fs_src, batch_gs_src, false});
+    if (!shader_) {
+      return false;
+    }
+    ubo_global_.Initialize();
+    ubo_terminals_.Initialize();
+    ubo_terminals_.buffer = {};
+
+    auto vbo = glo::VBO::Create();
+    glo::VertexLayout layouts[] = {
+        {{"i_Pos", 0}, GL_FLOAT, 3, 20, CELLS_OFFSET},
+        {{"i_Color", 1}, GL_UNSIGNED_BYTE, 4, 20, CELLS_OFFSET + 12},
+        {{"i_BgColor", 2}, GL_UNSIGNED_BYTE, 4, 20, CELLS_OFFSET + 16},
+        {{"i_Terminal", 3}, GL_FLOAT, 1, 4, 0, 1},
+    };
+    vao_ = glo::VAO::Create(vbo, layouts);
+    glGenBuffers(1, &indirect_);
+    return true;
+  }
+
+  int Acquire() {
+    for (int i = 0; i < GlBatch::MAX_TERMINALS; ++i) {
+      if (!slots_[i].used) {
+        slots_[i] = {};
+        slots_[i].used = true;
+        ubo_terminals_.buffer.terminals[i] = {};
+        relayout_ = true;
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  void Release(int slot) {
+    slots_[slot] = {};
+    ubo_terminals_.buffer.terminals[slot] = {};
+    relayout_ = true;
+  }
+
+  bool LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                 PixelSize cell_size) {
+    if (font_ && font_->atlas != atlas) {
+      PLOG_ERROR << "GlBatch: all terminals must use the same atlas";
+      return false;
+    }
+    if (!font_) {
+      font_ = context_->impl_->Font(atlas);
+      cell_size_ = cell_size;
+    }
+    return font_ != nullptr;
+  }
+
+  void Resize(int slot, int rows, int cols) {
+    auto &s = slots_[slot];
+    s.reserve = static_cast<uint32_t>(rows * cols);
+    if (s.reserve > s.capacity) {
+      relayout_ = true;
+    }
+  }
+
+  void UpdateCells(int slot, std::span<const CellVertex> cells,
+                   std::span<const uint32_t> changed) {
+    auto &s = slots_[slot];
+    if (cells.size() != s.cells.size()) {
+      s.cells.assign(cells.begin(), cells.end());
+      if (cells.size() > s.capacity) {
+        relayout_ = true;
+      }
+      s.Dirty(0, static_cast<uint32_t>(cells.size()));
+      return;
+    }
+    for (auto i : changed) {
+      s.cells[i] = cells[i];
+      s.Dirty(i, i + 1);
+    }
+  }
+
+  BatchTerminal &Terminal(int slot) {
+    return ubo_terminals_.buffer.terminals[slot];
+  }
+
+  void Draw(PixelSize target_size) {
+    if (!font_) {
+      return;
+    }
+    context_->impl_->uploader->Flush();
+    if (relayout_) {
+      Relayout();
+    } else {
+      UploadDirty();
+    }
+
+    commands_.clear();
+    for (uint32_t i = 0; i < GlBatch::MAX_TERMINALS; ++i) {
+      auto &s = slots_[i];
+      if (s.used && !s.cells.empty()) {
+        commands_.push_back({
+            .count = static_cast<uint32_t>(s.cells.size()),
+            .instance_count = 1,
+            .first = s.offset,
+            .base_instance = i,
+        });
+      }
+    }
+    if (commands_.empty()) {
+      return;
+    }
+
+    auto &global = ubo_global_.buffer;
+    global.cellSize[0] = (float)cell_size_.width;
+    global.cellSize[1] = (float)cell_size_.height;
+    global.screenSize[0] = (float)target_size.width;
+    global.screenSize[1] = (float)target_size.height;
+    global.atlasSize[0] = (float)font_->atlas->bitmap_width;
+    global.atlasSize[1] = (float)font_->atlas->bitmap_height;
+    global.ascent = font_->atlas->info.ascents;
+    global.descent = font_->atlas->info.descents;
+    global.UpdateProjection(target_size, cell_size_);
+    ubo_global_.Upload();
+    ubo_terminals_.Upload();
+
+    // stays bound. nothing else draws indirect
+    auto &state = glo::StateCache::Current();
+    state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 commands_.size() * sizeof(DrawArraysIndirectCommand),
+                 commands_.data(), GL_STREAM_DRAW);
+
+    auto shader_scope = ScopedBind(shader_);
+    auto texture_scope = ScopedBind(font_->texture);
+    shader_->SetUBO(0, ubo_global_.Handle());
+    shader_->SetUBO(1, font_->glyphs.Handle());
+    shader_->SetUBO(2, ubo_terminals_.Handle());
+    state.Enable(GL_BLEND);
+    state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for (int i = 0; i < 4; ++i) {
+      state.Enable(GL_CLIP_DISTANCE0 + i);
+    }
+    vao_->Bind();
+    glMultiDrawArraysIndirect(GL_POINTS, nullptr,
+                              static_cast<GLsizei>(commands_.size()), 0);
+    vao_->Unbind();
+    for (int i = 0; i < 4; ++i) {
+      state.Disable(GL_CLIP_DISTANCE0 + i);
+    }
+  }
+
+private:
+  // pack all slots and upload the whole buffer
+  void Relayout() {
+    uint32_t total = 0;
+    for (auto &s : slots_) {
+      if (s.used) {
+        s.offset = total;
+        s.capacity = std::max(s.reserve, static_cast<uint32_t>(s.cells.size()));
+        total += s.capacity;
+      }
+    }
+
+    std::vector<uint8_t> data(CELLS_OFFSET + total * sizeof(CellVertex));
+    auto ids = reinterpret_cast<float *>(data.data());
+    for (int i = 0; i < GlBatch::MAX_TERMINALS; ++i) {
+      ids[i] = static_cast<float>(i);
+    }
+    for (auto &s : slots_) {
+      if (s.used && !s.cells.empty()) {
+        memcpy(data.data() + CELLS_OFFSET + s.offset * sizeof(CellVertex),
+               s.cells.data(), s.cells.size() * sizeof(CellVertex));
+      }
+      s.dirty_begin = s.dirty_end = 0;
+    }
+    vao_->GetVBO()->SetData(static_cast<uint32_t>(data.size()), data.data(),
+                            true);
+    relayout_ = false;
+  }
+
+  void UploadDirty() {
+    auto vbo = vao_->GetVBO();
+    for (auto &s : slots_) {
+      if (!s.used || s.dirty_begin >= s.dirty_end) {
+        continue;
+      }
+      vbo->SetSubData(
+          s.cells.data() + s.dirty_begin,
+          static_cast<uint32_t>(CELLS_OFFSET +
+                                (s.offset + s.dirty_begin) * sizeof(CellVertex)),
+          static_cast<uint32_t>((s.dirty_end - s.dirty_begin) *
+                                sizeof(CellVertex)));
+      s.dirty_begin = s.dirty_end = 0;
+    }
+  }
+};
+
+//
+// GlBatchBackend
+//
+GlBatchBackend::GlBatchBackend(const std::shared_ptr<GlBatchImpl> &batch,
+                               int slot)
+    : batch_(batch), slot_(slot) {}
+
+GlBatchBackend::~GlBatchBackend() { batch_->Release(slot_); }
+
+void GlBatchBackend::SetOrigin(int x, int y) {
+  auto &terminal = batch_->Terminal(slot_);
+  terminal.rect[0] = static_cast<float>(x);
+  terminal.rect[1] = static_cast<float>(y);
+}
+
+bool GlBatchBackend::LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                               PixelSize cell_size) {
+  return batch_->LoadAtlas(atlas, cell_size);
+}
+
+void GlBatchBackend::Resize(int rows, int cols) {
+  batch_->Resize(slot_, rows, cols);
+}
+
+void GlBatchBackend::UpdateCells(std::span<const CellVertex> cells,
+                                 std::span<const uint32_t> changed) {
+  ScopedStageTimer stage(stats_, FrameStage::BufferUpload);
+  batch_->UpdateCells(slot_, cells, changed);
+}
+
+void GlBatchBackend::Render(PixelSize screen_size, PixelSize cell_size,
+                            std::chrono::nanoseconds duration) {
+  auto &terminal = batch_->Terminal(slot_);
+  terminal.rect[2] = static_cast<float>(screen_size.width);
+  terminal.rect[3] = static_cast<float>(screen_size.height);
+  // set again by RenderCursor
+  memset(terminal.cursor, 0, sizeof(terminal.cursor));
+}
+
+void GlBatchBackend::RenderCursor(int left, int top, int right, int bottom,
+                                  PixelSize screen_size) {
+  auto &terminal = batch_->Terminal(slot_);
+  terminal.cursor[0] = static_cast<float>(left);
+  terminal.cursor[1] = static_cast<float>(top);
+  terminal.cursor[2] = static_cast<float>(right);
+  terminal.cursor[3] = static_cast<float>(bottom);
+}
+
+//
+// GlBatch
+//
+GlBatch::GlBatch() : impl_(new GlBatchImpl) {}
+
+GlBatch::~GlBatch() {}
+
+std::shared_ptr<GlBatch>
+GlBatch::Create(const std::shared_ptr<GlRenderContext> &context) {
+  if (!context) {
+    return nullptr;
+  }
+  auto ptr = std::shared_ptr<GlBatch>(new GlBatch);
+  ptr->context_ = context;
+  if (!ptr->impl_->Initialize(context)) {
+    return nullptr;
+  }
+  return ptr;
+}
+
+std::shared_ptr<GlBatchBackend> GlBatch::CreateBackend() {
+  auto slot = impl_->Acquire();
+  if (slot < 0) {
+    PLOG_ERROR << "GlBatch: " << MAX_TERMINALS << " terminals are in use";
+    return nullptr;
+  }
+  return std::make_shared<GlBatchBackend>(impl_, slot);
+}
+
+void GlBatch::Draw(PixelSize target_size) { impl_->Draw(target_size); }
@@ -0,0 +1,60 @@
+#pragma once
+#include "gl_backend.h"
+#include "render_backend.h"
+#include <memory>
+
+class GlBatchImpl;
+
+/// A terminal of a GlBatch. Render and RenderCursor only store the cells,
+/// the rect and the cursor. GlBatch::Draw draws them.
+class GlBatchBackend : public RenderBackend {
+  std::shared_ptr<GlBatchImpl> batch_;
+  int slot_;
+  FrameStats *stats_ = nullptr;
+
+public:
+  GlBatchBackend(const std::shared_ptr<GlBatchImpl> &batch, int slot);
+  ~GlBatchBackend();
+  GlBatchBackend(const GlBatchBackend &) = delete;
+  GlBatchBackend &operator=(const GlBatchBackend &) = delete;
+  // top left in the batch target
+  void SetOrigin(int x, int y);
+  void SetStats(FrameStats *stats) override { stats_ = stats; }
+  // all terminals of a batch must use the same atlas
+  bool LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                 PixelSize cell_size) override;
+  void Resize(int rows, int cols) override;
+  void UpdateCells(std::span<const CellVertex> cells,
+                   std::span<const uint32_t> changed) override;
+  // the screen size is the clip rect
+  void Render(PixelSize screen_size, PixelSize cell_size,
+              std::chrono::nanoseconds duration) override;
+  void RenderCursor(int left, int top, int right, int bottom,
+                    PixelSize screen_size) override;
+};
+
+/// Draws the screens of many terminals with one glMultiDrawArraysIndirect.
+/// The cells of all terminals are packed into one vertex buffer, and each
+/// draw command picks its terminal's origin, clip rect and cursor from a UBO
+/// by its base instance. Draw uploads only the changed cell ranges.
+/// All terminals share one font. The scrollback view is not drawn.
+class GlBatch {
+  std::shared_ptr<GlRenderContext> context_;
+  std::shared_ptr<GlBatchImpl> impl_;
+
+  GlBatch();
+
+public:
+  static const int MAX_TERMINALS = 256;
+  ~GlBatch();
+  GlBatch(const GlBatch &) = delete;
+  GlBatch &operator=(const GlBatch &) = delete;
+  // nullptr if a shader fails. needs a current GL context
+  static std::shared_ptr<GlBatch>
+  Create(const std::shared_ptr<GlRenderContext> &context);
+  const std::shared_ptr<GlRenderContext> &Context() const { return context_; }
+  // nullptr if MAX_TERMINALS are in use
+  std::shared_ptr<GlBatchBackend> CreateBackend();
+  // all terminals into the bound framebuffer of target_size
+  void Draw(PixelSize target_size);
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include "fontatlas.h"
+#include <algorithm>
+#include <gl/glew.h>
+#include <glo/shader.h>
+#include <glo/texture.h>
+#include <glo/texture_uploader.h>
+#include <glo/ubo.h>
+#include <glo/uniform_ring.h>
+#include <memory>
+#include <plog/Log.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// internal to GlBackend and GlBatch
+
+struct Glyphs {
+  Glyph glyphs[128];
+};
+
+// uniform Global of the cell programs
+struct Global {
+  float projection[16] = {
+      1, 0, 0, 0, //
+      0, 1, 0, 0, //
+      0, 0, 1, 0, //
+      0, 0, 0, 1  //
+
+  };
+  float screenSize[2];
+  float cellSize[2];
+  float atlasSize[2];
+  float ascent;
+  float descent;
+  float scrollRows = 0;
+  float historyRows = 1;
+  float historyAnchor = 0;
+  // std140 block size
+  float padding = 0;
+
+  void UpdateProjection(PixelSize screen_size, PixelSize cell_size) {
+    auto m = projection;
+    m[0] = 2.0 / screen_size.width;
+    m[5] = -(2.0 / screen_size.height);
+    m[12] = -1 - cell_size.width / screen_size.width * 2;
+    m[13] = 1 + cell_size.height / screen_size.height * 2;
+  }
+};
+
+// atlas texture and glyph table of a font
+struct GlFont {
+  std::shared_ptr<const FontAtlas> atlas;
+  std::shared_ptr<glo::Texture> texture;
+  glo::TypedUBO<Glyphs> glyphs;
+
+  bool Initialize(const std::shared_ptr<const FontAtlas> &src,
+                  glo::TextureUploader *uploader) {
+    atlas = src;
+    texture = glo::Texture::Create(atlas->bitmap_width, atlas->bitmap_height,
+                                   GL_RED);
+    if (!texture) {
+      return false;
+    }
+    // through a pixel buffer. the driver does not copy the bitmap
+    if (!uploader) {
+      texture->Update(0, 0, atlas->bitmap_width, atlas->bitmap_height,
+                      atlas->bitmap.data());
+    } else if (!uploader->Upload(*texture, 0, 0, atlas->bitmap_width,
+                                 atlas->bitmap_height, atlas->bitmap.data())) {
+      // every buffer is busy. shows up when Render flushes
+      uploader->Post(texture, 0, 0, atlas->bitmap_width, atlas->bitmap_height,
+                     atlas->bitmap);
+    }
+    auto label = "atlas";
+    if ((__GLEW_EXT_debug_label)) {
+      glLabelObjectEXT(GL_TEXTURE, texture->Handle(), 0, label);
+    }
+    if ((__GLEW_KHR_debug)) {
+      glObjectLabel(GL_TEXTURE, texture->Handle(), -1, label);
+    }
+
+    glyphs.Initialize();
+    auto count = std::min(atlas->glyphs.size(), std::size(glyphs.buffer.glyphs));
+    if (count < atlas->glyphs.size()) {
+      PLOG_WARNING << "glyph table is full: " << atlas->glyphs.size();
+    }
+    for (size_t i = 0; i < count; ++i) {
+      glyphs.buffer.glyphs[i] = atlas->glyphs[i];
+    }
+    glyphs.Upload();
+    return true;
+  }
+};
+
+struct FontKey {
+  std::string path;
+  PixelSize cell_size;
+  uint32_t atlas_size;
+
+  bool operator==(const FontKey &rhs) const {
+    return path == rhs.path && cell_size.width == rhs.cell_size.width &&
+           cell_size.height == rhs.cell_size.height &&
+           atlas_size == rhs.atlas_size;
+  }
+};
+
+class GlRenderContextImpl {
+  // a few fonts at most. expired entries are reused
+  std::vector<std::pair<FontKey, std::weak_ptr<const FontAtlas>>> atlases_;
+  std::vector<std::weak_ptr<GlFont>> fonts_;
+
+public:
+  // cell programs specialized with or without history rows
+  std::shared_ptr<glo::ShaderProgram> shader;
+  std::shared_ptr<glo::ShaderProgram> screen_shader;
+  std::shared_ptr<glo::ShaderProgram> cursor_shader;
+  // uniform Global of every GlBackend. nullptr uploads to its own UBO
+  std::shared_ptr<glo::UniformRing> uniforms;
+  // atlas pages and pixels posted from other threads. flushed by Render
+  std::shared_ptr<glo::TextureUploader> uploader;
+
+  // compile the programs
+  bool Initialize();
+
+  std::shared_ptr<const FontAtlas> LoadFont(std::string_view path,
+                                            PixelSize cell_size,
+                                            uint32_t atlas_size) {
+    FontKey key{std::string(path), cell_size, atlas_size};
+    for (auto &[k, weak] : atlases_) {
+      if (k == key) {
+        if (auto atlas = weak.lock()) {
+          return atlas;
+        }
+      }
+    }
+    auto atlas = std::make_shared<FontAtlas>();
+    if (!atlas->Load(path, cell_size, atlas_size)) {
+      return nullptr;
+    }
+    std::erase_if(atlases_, [](auto &pair) { return pair.second.expired(); });
+    atlases_.push_back({key, atlas});
+    return atlas;
+  }
+
+  std::shared_ptr<GlFont> Font(const std::shared_ptr<const FontAtlas> &atlas) {
+    for (auto &weak : fonts_) {
+      auto font = weak.lock();
+      if (font && font->atlas == atlas) {
+        return font;
+      }
+    }
+    auto font = std::make_shared<GlFont>();
+    if (!font->Initialize(atlas, uploader.get())) {
+      return nullptr;
+    }
+    std::erase_if(fonts_, [](auto &weak) { return weak.expired(); });
+    fonts_.push_back(font);
+    return font;
+  }
+
+  size_t FontCount() const {
+    return std::count_if(fonts_.begin(), fonts_.end(),
+                         [](auto &weak) { return !weak.expired(); });
+  }
+};
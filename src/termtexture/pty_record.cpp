@@ -0,0 +1,253 @@
+#include "pty_record.h"
+#include <plog/Log.h>
+#include <string.h>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char PTY_RECORD_MAGIC[8] = {'T', 'T', 'R', 'E', 'C', '0', '0', '1'};
+const size_t PTY_RECORD_HEADER_SIZE = 12;
+
+//
+// PtyRecorder
+//
+PtyRecorder::PtyRecorder(FILE *fp)
+    : fp_(fp), start_(std::chrono::steady_clock::now()) {}
+
+PtyRecorder::~PtyRecorder() { fclose(fp_); }
+
+std::shared_ptr<PtyRecorder> PtyRecorder::Create(std::string_view path,
+                                                 int rows, int cols) {
+  auto fp = fopen(std::string(path).c_str(), "wb");
+  if (!fp) {
+    PLOG_ERROR << "fopen: " << path;
+    return nullptr;
+  }
+  uint8_t header[PTY_RECORD_HEADER_SIZE];
+  memcpy(header, PTY_RECORD_MAGIC, 8);
+  header[8] = static_cast<uint8_t>(rows);
+  header[9] = static_cast<uint8_t>(rows >> 8);
+  header[10] = static_cast<uint8_t>(cols);
+  header[11] = static_cast<uint8_t>(cols >> 8);
+  fwrite(header, 1, sizeof(header), fp);
+  fflush(fp);
+  return std::shared_ptr<PtyRecorder>(new PtyRecorder(fp));
+}
+
+void PtyRecorder::WriteVarint(uint64_t value) {
+  uint8_t buf[10];
+  size_t n = 0;
+  do {
+    uint8_t b = value & 0x7F;
+    value >>= 7;
+    buf[n++] = value ? (b | 0x80) : b;
+  } while (value);
+  fwrite(buf, 1, n, fp_);
+}
+
+void PtyRecorder::WriteHeader(PtyEventKind kind) {
+  auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_);
+  fputc(static_cast<uint8_t>(kind), fp_);
+  WriteVarint((now - last_).count());
+  last_ = now;
+}
+
+void PtyRecorder::Output(std::span<const char> bytes) {
+  if (bytes.empty()) {
+    return;
+  }
+  WriteHeader(PtyEventKind::Output);
+  WriteVarint(bytes.size());
+  fwrite(bytes.data(), 1, bytes.size(), fp_);
+  fflush(fp_);
+}
+
+void PtyRecorder::Resize(int rows, int cols) {
+  WriteHeader(PtyEventKind::Resize);
+  WriteVarint(rows);
+  WriteVarint(cols);
+  fflush(fp_);
+}
+
+//
+// MappedFile
+//
+struct MappedFile {
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#endif
+
+  bool Open(std::string_view path);
+  ~MappedFile();
+};
+
+#ifdef _WIN32
+bool MappedFile::Open(std::string_view path) {
+  file = CreateFileA(std::string(path).c_str(), GENERIC_READ, FILE_SHARE_READ,
+                     nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+    return false;
+  }
+  size = static_cast<size_t>(file_size.QuadPart);
+  mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    return false;
+  }
+  data = static_cast<const uint8_t *>(
+      MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  return data != nullptr;
+}
+
+MappedFile::~MappedFile() {
+  if (data) {
+    UnmapViewOfFile(data);
+  }
+  if (mapping) {
+    CloseHandle(mapping);
+  }
+  if (file != INVALID_HANDLE_VALUE) {
+    CloseHandle(file);
+  }
+}
+#else
+bool MappedFile::Open(std::string_view path) {
+  auto fd = open(std::string(path).c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  auto p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+  data = static_cast<const uint8_t *>(p);
+  size = st.st_size;
+  return true;
+}
+
+MappedFile::~MappedFile() {
+  if (data) {
+    munmap(const_cast<uint8_t *>(data), size);
+  }
+}
+#endif
+
+//
+// PtyRecording
+//
+PtyRecording::PtyRecording() {}
+
+PtyRecording::~PtyRecording() { delete file_; }
+
+std::shared_ptr<PtyRecording> PtyRecording::Open(std::string_view path) {
+  auto ptr = std::shared_ptr<PtyRecording>(new PtyRecording);
+  ptr->file_ = new MappedFile;
+  if (!ptr->file_->Open(path)) {
+    PLOG_ERROR << "open: " << path;
+    return nullptr;
+  }
+  auto data = ptr->file_->data;
+  if (ptr->file_->size < PTY_RECORD_HEADER_SIZE ||
+      memcmp(data, PTY_RECORD_MAGIC, 8) != 0) {
+    PLOG_ERROR << "not a recording: " << path;
+    return nullptr;
+  }
+  ptr->rows_ = data[8] | data[9] << 8;
+  ptr->cols_ = data[10] | data[11] << 8;
+  ptr->data_ = {data, ptr->file_->size};
+  ptr->Rewind();
+  return ptr;
+}
+
+void PtyRecording::Rewind() {
+  pos_ = PTY_RECORD_HEADER_SIZE;
+  time_ = {};
+}
+
+static bool ReadVarint(std::span<const uint8_t> data, size_t *pos,
+                       uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*pos >= data.size()) {
+      return false;
+    }
+    auto b = data[(*pos)++];
+    *value |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PtyRecording::NextTime(std::chrono::nanoseconds *time) const {
+  auto pos = pos_ + 1;
+  uint64_t delta;
+  if (pos_ >= data_.size() || !ReadVarint(data_, &pos, &delta)) {
+    return false;
+  }
+  *time = time_ + std::chrono::nanoseconds(delta);
+  return true;
+}
+
+bool PtyRecording::Next(PtyEvent *event) {
+  if (pos_ >= data_.size()) {
+    return false;
+  }
+  auto pos = pos_;
+  auto kind = static_cast<PtyEventKind>(data_[pos++]);
+  uint64_t delta;
+  if (!ReadVarint(data_, &pos, &delta)) {
+    return false;
+  }
+  *event = {
+      .kind = kind,
+      .time = time_ + std::chrono::nanoseconds(delta),
+  };
+  switch (kind) {
+  case PtyEventKind::Output: {
+    uint64_t size;
+    if (!ReadVarint(data_, &pos, &size) || size > data_.size() - pos) {
+      return false;
+    }
+    event->bytes = {reinterpret_cast<const char *>(data_.data() + pos),
+                    static_cast<size_t>(size)};
+    pos += size;
+    break;
+  }
+  case PtyEventKind::Resize: {
+    uint64_t rows, cols;
+    if (!ReadVarint(data_, &pos, &rows) || !ReadVarint(data_, &pos, &cols)) {
+      return false;
+    }
+    event->rows = static_cast<int>(rows);
+    event->cols = static_cast<int>(cols);
+    break;
+  }
+  default:
+    PLOG_ERROR << "unknown event: " << static_cast<int>(kind);
+    return false;
+  }
+  pos_ = pos;
+  time_ = event->time;
+  return true;
+}
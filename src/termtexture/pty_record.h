@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <span>
+#include <stdint.h>
+#include <stdio.h>
+#include <string_view>
+
+/// Raw pty output with timestamps.
+///
+/// file layout (little endian):
+///   "TTREC001" rows:u16 cols:u16
+///   event*
+/// event:
+///   kind:u8 delta_ns:varint
+///   kind 0 (output): size:varint bytes[size]
+///   kind 1 (resize): rows:varint cols:varint
+/// varint is LEB128. output bytes are stored as is, so a mapped file can be
+/// replayed without copying.
+enum class PtyEventKind : uint8_t {
+  Output = 0,
+  Resize = 1,
+};
+
+struct PtyEvent {
+  PtyEventKind kind;
+  // from the start of the recording
+  std::chrono::nanoseconds time;
+  // Output. points into the mapped file
+  std::span<const char> bytes;
+  // Resize
+  int rows;
+  int cols;
+};
+
+/// Writes a recording. Each event is flushed, that is one write per pty read,
+/// so a crash does not lose the tail of the capture.
+class PtyRecorder {
+  FILE *fp_ = nullptr;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::nanoseconds last_ = {};
+
+  PtyRecorder(FILE *fp);
+
+public:
+  ~PtyRecorder();
+  PtyRecorder(const PtyRecorder &) = delete;
+  PtyRecorder &operator=(const PtyRecorder &) = delete;
+  // nullptr if the file can not be created
+  static std::shared_ptr<PtyRecorder> Create(std::string_view path, int rows,
+                                             int cols);
+  void Output(std::span<const char> bytes);
+  void Resize(int rows, int cols);
+
+private:
+  void WriteHeader(PtyEventKind kind);
+  void WriteVarint(uint64_t value);
+};
+
+/// A recording mapped into memory.
+class PtyRecording {
+  struct MappedFile *file_ = nullptr;
+  std::span<const uint8_t> data_;
+  int rows_ = 0;
+  int cols_ = 0;
+  size_t pos_ = 0;
+  std::chrono::nanoseconds time_ = {};
+
+  PtyRecording();
+
+public:
+  ~PtyRecording();
+  PtyRecording(const PtyRecording &) = delete;
+  PtyRecording &operator=(const PtyRecording &) = delete;
+  // nullptr if the file is not a recording
+  static std::shared_ptr<PtyRecording> Open(std::string_view path);
+  int Rows() const { return rows_; }
+  int Cols() const { return cols_; }
+  std::span<const uint8_t> Data() const { return data_; }
+  void Rewind();
+  // false at the end or on a broken event
+  bool Next(PtyEvent *event);
+  // peek the time of the next event. false at the end
+  bool NextTime(std::chrono::nanoseconds *time) const;
+};
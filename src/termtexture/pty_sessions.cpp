@@ -0,0 +1,270 @@
+#include "pty_sessions.h"
+#include <plog/Log.h>
+#ifdef __linux__
+#include <algorithm>
+#include <errno.h>
+#include <mutex>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+struct PtySession {
+  void *user = nullptr;
+  // removed under the lock before it is deleted
+  common_pty::Pty *pty = nullptr;
+  int fd = -1;
+  size_t loop = 0;
+  // in ready_
+  bool ready = false;
+  // EPOLLHUP. not armed again
+  bool hung_up = false;
+};
+
+class PtySessionsImpl : public std::enable_shared_from_this<PtySessionsImpl> {
+  struct Loop {
+    int epoll = -1;
+    // wakes up the loop to stop
+    int stop = -1;
+    std::thread thread;
+  };
+  // epoll data of the stop event. session ids start from 1
+  static const uint64_t STOP = 0;
+
+  std::vector<Loop> loops_;
+  mutable std::mutex mutex_;
+  std::unordered_map<uint64_t, PtySession> sessions_;
+  std::vector<uint64_t> ready_;
+  uint64_t next_id_ = 1;
+  size_t next_loop_ = 0;
+  std::function<void()> wake_;
+
+public:
+  ~PtySessionsImpl() {
+    for (auto &loop : loops_) {
+      if (loop.stop >= 0) {
+        uint64_t one = 1;
+        write(loop.stop, &one, sizeof(one));
+      }
+      if (loop.thread.joinable()) {
+        loop.thread.join();
+      }
+      if (loop.stop >= 0) {
+        close(loop.stop);
+      }
+      if (loop.epoll >= 0) {
+        close(loop.epoll);
+      }
+    }
+  }
+
+  bool Initialize(size_t count) {
+    loops_ = std::vector<Loop>(std::max<size_t>(count, 1));
+    for (auto &loop : loops_) {
+      loop.epoll = epoll_create1(EPOLL_CLOEXEC);
+      loop.stop = eventfd(0, EFD_CLOEXEC);
+      if (loop.epoll < 0 || loop.stop < 0) {
+        PLOG_ERROR << "epoll: " << strerror(errno);
+        return false;
+      }
+      epoll_event event{.events = EPOLLIN, .data = {.u64 = STOP}};
+      epoll_ctl(loop.epoll, EPOLL_CTL_ADD, loop.stop, &event);
+    }
+    for (auto &loop : loops_) {
+      loop.thread = std::thread([this, epoll = loop.epoll]() { Run(epoll); });
+    }
+    return true;
+  }
+
+  void SetWake(const std::function<void()> &wake) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_ = wake;
+  }
+
+  std::shared_ptr<common_pty::Pty> Launch(int rows, int cols, const char *cmd,
+                                          void *user) {
+    uint64_t id;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      id = next_id_++;
+    }
+    std::weak_ptr<PtySessionsImpl> weak = weak_from_this();
+    // leave the loop before the fd is closed
+    auto pty = std::shared_ptr<common_pty::Pty>(
+        new common_pty::Pty, [weak, id](common_pty::Pty *p) {
+          if (auto self = weak.lock()) {
+            self->Remove(id);
+          }
+          delete p;
+        });
+    pty->SetPolled([weak, id]() {
+      if (auto self = weak.lock()) {
+        self->Arm(id);
+      }
+    });
+    pty->Launch(rows, cols, cmd);
+    if (pty->Fd() < 0) {
+      return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto loop = next_loop_++ % loops_.size();
+    sessions_[id] = {
+        .user = user,
+        .pty = pty.get(),
+        .fd = pty->Fd(),
+        .loop = loop,
+    };
+    epoll_event event{.events = EPOLLIN | EPOLLONESHOT, .data = {.u64 = id}};
+    if (epoll_ctl(loops_[loop].epoll, EPOLL_CTL_ADD, pty->Fd(), &event) < 0) {
+      PLOG_ERROR << "epoll_ctl: " << strerror(errno);
+      sessions_.erase(id);
+      return nullptr;
+    }
+    return pty;
+  }
+
+  void TakeReady(std::vector<void *> &users) {
+    users.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto id : ready_) {
+      auto found = sessions_.find(id);
+      if (found != sessions_.end()) {
+        found->second.ready = false;
+        users.push_back(found->second.user);
+      }
+    }
+    ready_.clear();
+  }
+
+  size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.size();
+  }
+
+private:
+  // after the host has read the pty
+  void Arm(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = sessions_.find(id);
+    if (found == sessions_.end() || found->second.hung_up) {
+      return;
+    }
+    auto &session = found->second;
+    epoll_event event{.events = EPOLLIN | EPOLLONESHOT, .data = {.u64 = id}};
+    epoll_ctl(loops_[session.loop].epoll, EPOLL_CTL_MOD, session.fd, &event);
+  }
+
+  void Remove(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = sessions_.find(id);
+    if (found == sessions_.end()) {
+      return;
+    }
+    auto &session = found->second;
+    epoll_ctl(loops_[session.loop].epoll, EPOLL_CTL_DEL, session.fd, nullptr);
+    std::erase(ready_, id);
+    sessions_.erase(found);
+  }
+
+  void Run(int epoll) {
+    epoll_event events[64];
+    while (true) {
+      auto n = epoll_wait(epoll, events, static_cast<int>(std::size(events)),
+                          -1);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        PLOG_ERROR << "epoll_wait: " << strerror(errno);
+        return;
+      }
+
+      bool stop = false;
+      std::function<void()> wake;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < n; ++i) {
+          auto id = events[i].data.u64;
+          if (id == STOP) {
+            stop = true;
+            continue;
+          }
+          // removed while waiting
+          auto found = sessions_.find(id);
+          if (found == sessions_.end()) {
+            continue;
+          }
+          auto &session = found->second;
+          if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+            session.hung_up = true;
+          }
+          // Read reads it and arms it again
+          session.pty->SetReady();
+          if (session.ready) {
+            continue;
+          }
+          if (ready_.empty()) {
+            wake = wake_;
+          }
+          session.ready = true;
+          ready_.push_back(id);
+        }
+      }
+      if (wake) {
+        wake();
+      }
+      if (stop) {
+        return;
+      }
+    }
+  }
+};
+
+#else
+
+class PtySessionsImpl {
+public:
+  bool Initialize(size_t count) {
+    PLOG_ERROR << "PtySessions needs epoll";
+    return false;
+  }
+  void SetWake(const std::function<void()> &wake) {}
+  std::shared_ptr<common_pty::Pty> Launch(int rows, int cols, const char *cmd,
+                                          void *user) {
+    return nullptr;
+  }
+  void TakeReady(std::vector<void *> &users) { users.clear(); }
+  size_t Size() const { return 0; }
+};
+
+#endif
+
+PtySessions::PtySessions() : impl_(new PtySessionsImpl) {}
+
+PtySessions::~PtySessions() {}
+
+std::shared_ptr<PtySessions> PtySessions::Create(size_t loops) {
+  auto ptr = std::shared_ptr<PtySessions>(new PtySessions);
+  if (!ptr->impl_->Initialize(loops)) {
+    return nullptr;
+  }
+  return ptr;
+}
+
+void PtySessions::SetWake(const std::function<void()> &wake) {
+  impl_->SetWake(wake);
+}
+
+std::shared_ptr<common_pty::Pty>
+PtySessions::Launch(int rows, int cols, const char *cmd, void *user) {
+  return impl_->Launch(rows, cols, cmd, user);
+}
+
+void PtySessions::TakeReady(std::vector<void *> &users) {
+  impl_->TakeReady(users);
+}
+
+size_t PtySessions::Size() const { return impl_->Size(); }
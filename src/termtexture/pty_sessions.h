@@ -0,0 +1,35 @@
+#pragma once
+#include "common_pty.h"
+#include <functional>
+#include <memory>
+#include <stddef.h>
+#include <vector>
+
+/// Many ptys read by a few epoll loops instead of a thread per pty.
+/// A loop only marks a session ready when its pty has output. The host reads
+/// the ready ptys, which arms them again, and leaves idle sessions alone.
+/// Pty::Read of a session that was not reported returns nothing without a
+/// read, so rendering every terminal does not touch the idle ptys.
+/// Linux only. Create returns nullptr elsewhere.
+class PtySessions {
+  std::shared_ptr<class PtySessionsImpl> impl_;
+
+  PtySessions();
+
+public:
+  ~PtySessions();
+  PtySessions(const PtySessions &) = delete;
+  PtySessions &operator=(const PtySessions &) = delete;
+  // loops threads. sessions are spread over them
+  static std::shared_ptr<PtySessions> Create(size_t loops = 1);
+  // called on a loop thread when the first session becomes ready after
+  // TakeReady, e.g. glfwPostEmptyEvent
+  void SetWake(const std::function<void()> &wake);
+  // a pty polled by the loops. user is reported by TakeReady.
+  // the session ends with the pty. nullptr if the launch fails
+  std::shared_ptr<common_pty::Pty> Launch(int rows, int cols, const char *cmd,
+                                          void *user);
+  // users of sessions that have output or hung up since the last call
+  void TakeReady(std::vector<void *> &users);
+  size_t Size() const;
+};
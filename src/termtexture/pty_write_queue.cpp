@@ -0,0 +1,175 @@
+#include "pty_write_queue.h"
+#include "trace.h"
+#include <algorithm>
+#include <plog/Log.h>
+
+namespace common_pty {
+
+WriteQueue::WriteQueue(const WriteFunc &write, const InterruptFunc &interrupt,
+                       size_t capacity)
+    : write_(write), interrupt_(interrupt), capacity_(capacity) {}
+
+WriteQueue::~WriteQueue() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    if (interrupt_) {
+      interrupt_(thread_);
+    }
+    thread_.join();
+  }
+  for (auto &item : items_) {
+    if (item.stream) {
+      item.stream->done_ = true;
+    }
+  }
+}
+
+bool WriteQueue::Push(const char *data, size_t size) {
+  if (size == 0) {
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (broken_ || bytes_ + size > capacity_) {
+      return false;
+    }
+    if (items_.empty() || items_.back().stream) {
+      items_.push_back({});
+    }
+    // coalesce
+    auto &bytes = items_.back().bytes;
+    bytes.insert(bytes.end(), data, data + size);
+    bytes_ += size;
+    Start();
+  }
+  cv_.notify_one();
+  return true;
+}
+
+std::shared_ptr<WriteStream> WriteQueue::Stream(std::string data,
+                                                std::string suffix) {
+  auto stream =
+      std::make_shared<WriteStream>(std::move(data), std::move(suffix));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (broken_) {
+      stream->done_ = true;
+      return stream;
+    }
+    items_.push_back({.stream = stream});
+    Start();
+  }
+  cv_.notify_one();
+  return stream;
+}
+
+size_t WriteQueue::Pending() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+bool WriteQueue::IsBroken() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return broken_;
+}
+
+// under the lock
+void WriteQueue::Start() {
+  if (!thread_.joinable()) {
+    thread_ = std::thread([this]() { Run(); });
+  }
+}
+
+void WriteQueue::Run() {
+  tracing::SetThreadName("pty writer");
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() { return stop_ || !items_.empty(); });
+    if (stop_) {
+      return;
+    }
+
+    if (auto stream = items_.front().stream) {
+      // one chunk per turn. the front stays until the stream is done
+      lock.unlock();
+      auto written = stream->written_.load();
+      bool ok;
+      if (!stream->cancel_ && written < stream->data_.size()) {
+        auto size = std::min(STREAM_CHUNK, stream->data_.size() - written);
+        TRACE_SCOPE("Pty::WriteStream");
+        ok = WriteAll(stream->data_.data() + written, size);
+        if (ok) {
+          stream->written_ = written + size;
+        }
+      } else {
+        ok = WriteAll(stream->suffix_.data(), stream->suffix_.size());
+        if (ok) {
+          stream->done_ = true;
+        }
+      }
+      lock.lock();
+      if (stream->done_) {
+        items_.pop_front();
+      }
+      if (!ok) {
+        Break();
+      }
+    } else {
+      std::vector<char> bytes;
+      std::swap(bytes, items_.front().bytes);
+      items_.pop_front();
+      bytes_ -= bytes.size();
+      lock.unlock();
+      bool ok;
+      {
+        TRACE_SCOPE("Pty::Write");
+        ok = WriteAll(bytes.data(), bytes.size());
+      }
+      lock.lock();
+      if (!ok) {
+        Break();
+      }
+    }
+  }
+}
+
+// without the lock
+bool WriteQueue::WriteAll(const char *data, size_t size) {
+  while (size > 0) {
+    auto n = write_(data, size);
+    if (n < 0) {
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) {
+        return false;
+      }
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+// under the lock. the pty is gone or stopping. drop everything
+void WriteQueue::Break() {
+  if (stop_) {
+    return;
+  }
+  PLOG_WARNING << "pty write failed. drop " << bytes_ << " bytes";
+  broken_ = true;
+  for (auto &item : items_) {
+    if (item.stream) {
+      item.stream->done_ = true;
+    }
+  }
+  items_.clear();
+  bytes_ = 0;
+}
+
+} // namespace common_pty
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace common_pty {
+
+/// A large write, e.g. a paste, streamed by a WriteQueue in chunks.
+/// Writes queued after it wait until it is done.
+class WriteStream {
+  friend class WriteQueue;
+  std::string data_;
+  // written after data, also when cancelled. e.g. the end of a bracketed paste
+  std::string suffix_;
+  std::atomic<size_t> written_ = 0;
+  std::atomic<bool> cancel_ = false;
+  std::atomic<bool> done_ = false;
+
+public:
+  WriteStream(std::string data, std::string suffix)
+      : data_(std::move(data)), suffix_(std::move(suffix)) {}
+  WriteStream(const WriteStream &) = delete;
+  WriteStream &operator=(const WriteStream &) = delete;
+  size_t Size() const { return data_.size(); }
+  size_t Written() const { return written_; }
+  float Progress() const {
+    return data_.empty() ? 1.0f : static_cast<float>(written_) / data_.size();
+  }
+  // written, cancelled or the pty is gone
+  bool IsDone() const { return done_; }
+  // stop after the current chunk. the suffix is still written
+  void Cancel() { cancel_ = true; }
+};
+
+/// Bytes to the child written on a writer thread, so that a child that stops
+/// reading does not block the caller. Consecutive small writes are coalesced
+/// into one. The thread starts with the first write.
+class WriteQueue {
+public:
+  // write some of the bytes. returns the written size, 0 to be called again
+  // or -1 on error. should return now and then for the destructor
+  using WriteFunc = std::function<int64_t(const char *data, size_t size)>;
+  // unblocks a WriteFunc waiting for the child. called by the destructor
+  using InterruptFunc = std::function<void(std::thread &writer)>;
+
+  static constexpr size_t CAPACITY = 1024 * 1024;
+  static constexpr size_t STREAM_CHUNK = 64 * 1024;
+
+private:
+  struct Item {
+    std::vector<char> bytes;
+    std::shared_ptr<WriteStream> stream;
+  };
+
+  WriteFunc write_;
+  InterruptFunc interrupt_;
+  size_t capacity_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Item> items_;
+  // in the bytes of items_
+  size_t bytes_ = 0;
+  bool stop_ = false;
+  bool broken_ = false;
+  std::thread thread_;
+
+public:
+  WriteQueue(const WriteFunc &write, const InterruptFunc &interrupt = {},
+             size_t capacity = CAPACITY);
+  ~WriteQueue();
+  WriteQueue(const WriteQueue &) = delete;
+  WriteQueue &operator=(const WriteQueue &) = delete;
+  // never blocks. false if the queued bytes exceed the capacity or the pty is
+  // gone. nothing is queued then
+  bool Push(const char *data, size_t size);
+  std::shared_ptr<WriteStream> Stream(std::string data,
+                                      std::string suffix = {});
+  // queued bytes, not counting streams
+  size_t Pending();
+  // a write failed, e.g. the child closed the pty. later pushes fail
+  bool IsBroken();
+
+private:
+  void Start();
+  void Run();
+  bool WriteAll(const char *data, size_t size);
+  void Break();
+};
+
+} // namespace common_pty
@@ -0,0 +1,69 @@
+#pragma once
+#include "celltypes.h"
+#include <chrono>
+#include <memory>
+#include <span>
+#include <stdint.h>
+
+struct FontAtlas;
+class FrameStats;
+
+struct CellVertex {
+  float col;
+  // < 0 is -(history slot + 1)
+  float row;
+  float glyph_index;
+  uint8_t fg_color[4];
+  uint8_t bg_color[4];
+};
+
+// vertices of the history ring to draw
+struct HistoryRange {
+  int offset;
+  int count;
+};
+
+/// Draws what CellGrid and Cursor have built.
+/// GlBackend is the default. CpuRasterizer draws into memory and
+/// NullBackend draws nothing.
+class RenderBackend {
+public:
+  virtual ~RenderBackend() {}
+  // upload and draw timings. nullptr disables
+  virtual void SetStats(FrameStats *stats) {}
+  // glyph upload. the atlas may be shared with other terminals
+  virtual bool LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                         PixelSize cell_size) = 0;
+  virtual void Resize(int rows, int cols) {}
+  // all screen cells. changed are indices updated since the last call
+  virtual void UpdateCells(std::span<const CellVertex> cells,
+                           std::span<const uint32_t> changed) = 0;
+  // history ring. see CellGrid::SetScroll
+  virtual void AllocateHistory(int rows, int cols) {}
+  virtual void UpdateHistoryRow(int slot, std::span<const CellVertex> cells) {}
+  virtual void SetScroll(float scroll_rows, int history_rows, int anchor,
+                         std::span<const HistoryRange> ranges) {}
+  virtual void Render(PixelSize screen_size, PixelSize cell_size,
+                      std::chrono::nanoseconds duration) = 0;
+  // invert the pixel rect
+  virtual void RenderCursor(int left, int top, int right, int bottom,
+                            PixelSize screen_size) = 0;
+};
+
+/// Accepts everything and draws nothing. for benchmarks of the terminal side.
+class NullBackend : public RenderBackend {
+public:
+  static std::shared_ptr<NullBackend> Create() {
+    return std::make_shared<NullBackend>();
+  }
+  bool LoadAtlas(const std::shared_ptr<const FontAtlas> &atlas,
+                 PixelSize cell_size) override {
+    return true;
+  }
+  void UpdateCells(std::span<const CellVertex> cells,
+                   std::span<const uint32_t> changed) override {}
+  void Render(PixelSize screen_size, PixelSize cell_size,
+              std::chrono::nanoseconds duration) override {}
+  void RenderCursor(int left, int top, int right, int bottom,
+                    PixelSize screen_size) override {}
+};
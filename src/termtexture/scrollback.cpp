@@ -0,0 +1,699 @@
+#include "scrollback.h"
+#include "blockcodec.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <string.h>
+#include <thread>
+
+const uint32_t CONTINUATION = CONTINUATION_CODEPOINT;
+
+static uint16_t PackAttrs(const VTermScreenCellAttrs &attrs) {
+  return attrs.bold                 //
+         | attrs.underline << 1     //
+         | attrs.italic << 3        //
+         | attrs.blink << 4         //
+         | attrs.reverse << 5       //
+         | attrs.conceal << 6       //
+         | attrs.strike << 7        //
+         | attrs.font << 8          //
+         | attrs.dwl << 12          //
+         | attrs.dwhl << 13;
+}
+
+static void UnpackAttrs(uint16_t value, VTermScreenCellAttrs *attrs) {
+  attrs->bold = value & 1;
+  attrs->underline = (value >> 1) & 3;
+  attrs->italic = (value >> 3) & 1;
+  attrs->blink = (value >> 4) & 1;
+  attrs->reverse = (value >> 5) & 1;
+  attrs->conceal = (value >> 6) & 1;
+  attrs->strike = (value >> 7) & 1;
+  attrs->font = (value >> 8) & 15;
+  attrs->dwl = (value >> 12) & 1;
+  attrs->dwhl = (value >> 13) & 3;
+}
+
+static bool IsSameColor(const VTermColor &lhs, const VTermColor &rhs) {
+  if (lhs.type != rhs.type) {
+    return false;
+  }
+  if (VTERM_COLOR_IS_INDEXED(&lhs)) {
+    return lhs.indexed.idx == rhs.indexed.idx;
+  }
+  return lhs.rgb.red == rhs.rgb.red && lhs.rgb.green == rhs.rgb.green &&
+         lhs.rgb.blue == rhs.rgb.blue;
+}
+
+static uint8_t CodepointSize(uint32_t codepoint) {
+  if (codepoint == CONTINUATION) {
+    return 2;
+  }
+  if (codepoint < 0x100) {
+    return 1;
+  }
+  if (codepoint < 0xFFFF) {
+    return 2;
+  }
+  return 4;
+}
+
+//
+// ScrollbackStyle
+//
+bool ScrollbackStyle::operator==(const ScrollbackStyle &rhs) const {
+  return attrs == rhs.attrs && IsSameColor(fg, rhs.fg) &&
+         IsSameColor(bg, rhs.bg);
+}
+
+size_t ScrollbackStyle::Hash() const {
+  auto color = [](const VTermColor &c) -> uint32_t {
+    if (VTERM_COLOR_IS_INDEXED(&c)) {
+      return c.type << 24 | c.indexed.idx;
+    }
+    return c.type << 24 | c.rgb.red << 16 | c.rgb.green << 8 | c.rgb.blue;
+  };
+  return std::hash<uint64_t>{}(static_cast<uint64_t>(color(fg)) << 32 |
+                               color(bg)) ^
+         attrs;
+}
+
+//
+// ScrollbackChunk
+//
+uint16_t ScrollbackChunk::StyleIndex(const ScrollbackStyle &style) {
+  auto hash = style.Hash();
+  auto [begin, end] = style_map.equal_range(hash);
+  for (auto it = begin; it != end; ++it) {
+    if (styles[it->second] == style) {
+      return it->second;
+    }
+  }
+  auto index = static_cast<uint16_t>(styles.size());
+  styles.push_back(style);
+  style_map.emplace(hash, index);
+  return index;
+}
+
+uint32_t ScrollbackChunk::Codepoint(const ScrollbackLine &line,
+                                    size_t col) const {
+  auto p = text.data() + line.text_offset;
+  switch (line.codepoint_size) {
+  case 1:
+    return p[col];
+  case 2: {
+    uint16_t value;
+    memcpy(&value, p + col * 2, 2);
+    return value == 0xFFFF ? CONTINUATION : value;
+  }
+  default: {
+    uint32_t value;
+    memcpy(&value, p + col * 4, 4);
+    return value;
+  }
+  }
+}
+
+void ScrollbackChunk::Seal() {
+  sealed = true;
+  style_map = {};
+  lines.shrink_to_fit();
+  runs.shrink_to_fit();
+  styles.shrink_to_fit();
+  text.shrink_to_fit();
+}
+
+bool ScrollbackChunk::Reopen() {
+  if (!Decompress()) {
+    return false;
+  }
+  ++generation;
+  sealed = false;
+  stored_raw = false;
+  style_map.clear();
+  for (size_t i = 0; i < styles.size(); ++i) {
+    style_map.emplace(styles[i].Hash(), static_cast<uint16_t>(i));
+  }
+  return true;
+}
+
+struct ScrollbackChunkHeader {
+  uint32_t lines;
+  uint32_t runs;
+  uint32_t styles;
+  uint32_t text;
+};
+
+template <typename T>
+static uint8_t *WriteArray(uint8_t *p, const std::vector<T> &values) {
+  if (!values.empty()) {
+    memcpy(p, values.data(), values.size() * sizeof(T));
+  }
+  return p + values.size() * sizeof(T);
+}
+
+template <typename T>
+static const uint8_t *ReadArray(const uint8_t *p, uint32_t count,
+                                std::vector<T> &values) {
+  values.resize(count);
+  if (count) {
+    memcpy(values.data(), p, count * sizeof(T));
+  }
+  return p + count * sizeof(T);
+}
+
+size_t ScrollbackChunk::RawSize() const {
+  return sizeof(ScrollbackChunkHeader) +
+         lines.size() * sizeof(ScrollbackLine) +
+         runs.size() * sizeof(ScrollbackRun) +
+         styles.size() * sizeof(ScrollbackStyle) + text.size();
+}
+
+std::vector<uint8_t> ScrollbackChunk::Serialize() const {
+  ScrollbackChunkHeader header{
+      .lines = static_cast<uint32_t>(lines.size()),
+      .runs = static_cast<uint32_t>(runs.size()),
+      .styles = static_cast<uint32_t>(styles.size()),
+      .text = static_cast<uint32_t>(text.size()),
+  };
+  std::vector<uint8_t> raw(RawSize());
+  auto p = raw.data();
+  memcpy(p, &header, sizeof(header));
+  p = WriteArray(p + sizeof(header), lines);
+  p = WriteArray(p, runs);
+  p = WriteArray(p, styles);
+  WriteArray(p, text);
+  return raw;
+}
+
+bool ScrollbackChunk::Deserialize(std::span<const uint8_t> raw) {
+  ScrollbackChunkHeader header;
+  if (raw.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, raw.data(), sizeof(header));
+  if (raw.size() != sizeof(header) + header.lines * sizeof(ScrollbackLine) +
+                        header.runs * sizeof(ScrollbackRun) +
+                        header.styles * sizeof(ScrollbackStyle) +
+                        header.text) {
+    return false;
+  }
+  auto p = ReadArray(raw.data() + sizeof(header), header.lines, lines);
+  p = ReadArray(p, header.runs, runs);
+  p = ReadArray(p, header.styles, styles);
+  ReadArray(p, header.text, text);
+  return true;
+}
+
+bool ScrollbackChunk::Decompress() {
+  if (!IsCompressed()) {
+    return true;
+  }
+  std::vector<uint8_t> raw(raw_size);
+  if (!blockcodec::Decompress(compressed, raw) || !Deserialize(raw)) {
+    return false;
+  }
+  compressed = {};
+  compressed_lines = 0;
+  raw_size = 0;
+  return true;
+}
+
+//
+// background compression
+//
+struct ScrollbackCompressJob {
+  std::weak_ptr<ScrollbackChunk> chunk;
+  uint32_t generation;
+  std::vector<uint8_t> raw;
+  std::vector<uint8_t> compressed;
+  std::atomic<bool> done = false;
+  std::function<void()> on_done;
+};
+
+class ScrollbackCompressWorker {
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::shared_ptr<ScrollbackCompressJob>> queue_;
+  bool stop_ = false;
+  std::thread thread_;
+
+  ScrollbackCompressWorker() : thread_([this]() { Run(); }) {}
+
+public:
+  ~ScrollbackCompressWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  // shared by all Scrollback
+  static ScrollbackCompressWorker &Instance() {
+    static ScrollbackCompressWorker s_worker;
+    return s_worker;
+  }
+
+  void Enqueue(const std::shared_ptr<ScrollbackCompressJob> &job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(job);
+    }
+    cv_.notify_one();
+  }
+
+private:
+  void Run() {
+    while (true) {
+      std::shared_ptr<ScrollbackCompressJob> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (stop_) {
+          return;
+        }
+        job = queue_.front();
+        queue_.pop_front();
+      }
+      blockcodec::Compress(job->raw, job->compressed);
+      job->raw = {};
+      job->done = true;
+      if (job->on_done) {
+        job->on_done();
+      }
+    }
+  }
+};
+
+static void RestoreLine(const ScrollbackChunk &chunk,
+                        const ScrollbackLine &line, int cols,
+                        VTermScreenCell *cells) {
+  size_t run = 0;
+  size_t remaining = line.run_count ? chunk.runs[line.run_offset].length : 0;
+  for (int col = 0; col < cols; ++col) {
+    auto &cell = cells[col];
+    cell = {};
+    cell.width = 1;
+    if (col < line.cells) {
+      cell.chars[0] = chunk.Codepoint(line, col);
+      if (col + 1 < line.cells &&
+          chunk.Codepoint(line, col + 1) == CONTINUATION) {
+        cell.width = 2;
+      }
+    }
+
+    if (!line.run_count) {
+      continue;
+    }
+    while (remaining == 0 && run + 1 < line.run_count) {
+      ++run;
+      remaining = chunk.runs[line.run_offset + run].length;
+    }
+    if (remaining) {
+      --remaining;
+    }
+    auto &style = chunk.styles[chunk.runs[line.run_offset + run].style];
+    UnpackAttrs(style.attrs, &cell.attrs);
+    cell.fg = style.fg;
+    cell.bg = style.bg;
+  }
+}
+
+//
+// Scrollback
+//
+Scrollback::Scrollback(size_t max_lines, size_t max_bytes)
+    : max_lines_(max_lines), max_bytes_(max_bytes) {}
+
+Scrollback::~Scrollback() {}
+
+void Scrollback::SetLimit(size_t max_lines, size_t max_bytes) {
+  max_lines_ = max_lines;
+  max_bytes_ = max_bytes;
+  Evict();
+}
+
+void Scrollback::SetCompression(bool enable, size_t hot_chunks) {
+  compression_ = enable;
+  hot_chunks_ = hot_chunks;
+  ScheduleCompress();
+}
+
+void Scrollback::Clear() {
+  first_line_number_ += size_;
+  chunks_.clear();
+  jobs_.clear();
+  cache_.clear();
+  size_ = 0;
+  bytes_ = 0;
+}
+
+void Scrollback::Update() {
+  for (auto it = jobs_.begin(); it != jobs_.end();) {
+    auto &job = **it;
+    if (!job.done) {
+      ++it;
+      continue;
+    }
+    auto chunk = job.chunk.lock();
+    if (chunk) {
+      chunk->compressing = false;
+    }
+    // a modified chunk is scheduled again
+    if (chunk && chunk->generation == job.generation &&
+        !chunk->IsCompressed()) {
+      if (job.compressed.size() >= chunk->Bytes()) {
+        chunk->stored_raw = true;
+      } else {
+        auto before = chunk->Bytes();
+        chunk->compressed_lines = static_cast<uint32_t>(chunk->lines.size());
+        chunk->raw_size = static_cast<uint32_t>(chunk->RawSize());
+        chunk->compressed = std::move(job.compressed);
+        chunk->lines = {};
+        chunk->runs = {};
+        chunk->styles = {};
+        chunk->text = {};
+        bytes_ -= before - chunk->Bytes();
+      }
+    }
+    it = jobs_.erase(it);
+  }
+  Evict();
+}
+
+void Scrollback::ScheduleCompress() {
+  if (!compression_ || chunks_.size() <= hot_chunks_ + 1) {
+    return;
+  }
+  // chunks_.back() is not sealed
+  auto end = chunks_.size() - std::max<size_t>(hot_chunks_, 1);
+  for (size_t i = end; i-- > 0;) {
+    auto &chunk = chunks_[i];
+    if (chunk->IsCompressed()) {
+      break;
+    }
+    if (chunk->compressing || chunk->stored_raw) {
+      continue;
+    }
+    chunk->compressing = true;
+    auto job = std::make_shared<ScrollbackCompressJob>();
+    job->chunk = chunk;
+    job->generation = chunk->generation;
+    job->raw = chunk->Serialize();
+    job->on_done = on_compressed_;
+    jobs_.push_back(job);
+    ScrollbackCompressWorker::Instance().Enqueue(job);
+  }
+}
+
+void Scrollback::Push(int cols, const VTermScreenCell *cells) {
+  Update();
+
+  if (!chunks_.empty() && chunks_.back()->sealed) {
+    // the chunks after it were popped
+    auto &back = *chunks_.back();
+    auto before = back.Bytes();
+    cache_.remove_if([p = &back](auto &kv) { return kv.first == p; });
+    if (back.Reopen()) {
+      bytes_ -= before;
+      bytes_ += back.Bytes();
+    }
+  }
+  if (chunks_.empty() || chunks_.back()->sealed ||
+      chunks_.back()->IsFull(cols)) {
+    if (!chunks_.empty() && !chunks_.back()->sealed) {
+      chunks_.back()->Seal();
+    }
+    chunks_.push_back(
+        std::make_shared<ScrollbackChunk>(first_line_number_ + size_));
+    // the index and the header. RemoveChunk takes them back
+    bytes_ += chunks_.back()->Bytes();
+    ScheduleCompress();
+  }
+  auto &chunk = *chunks_.back();
+  auto before = chunk.Bytes();
+
+  ScrollbackLine line{
+      .text_offset = static_cast<uint32_t>(chunk.text.size()),
+      .run_offset = static_cast<uint32_t>(chunk.runs.size()),
+      .cols = static_cast<uint16_t>(cols),
+  };
+
+  // attributes
+  ScrollbackStyle last{};
+  for (int col = 0; col < cols; ++col) {
+    auto &cell = cells[col];
+    ScrollbackStyle style{
+        .attrs = PackAttrs(cell.attrs),
+        .fg = cell.fg,
+        .bg = cell.bg,
+    };
+    if (line.run_count && style == last) {
+      ++chunk.runs.back().length;
+      continue;
+    }
+    chunk.runs.push_back({
+        .length = 1,
+        .style = chunk.StyleIndex(style),
+    });
+    ++line.run_count;
+    last = style;
+  }
+
+  // trim trailing blanks in the last run
+  int stored = cols;
+  if (line.run_count) {
+    auto last_run_begin = cols - chunk.runs.back().length;
+    while (stored > last_run_begin && cells[stored - 1].chars[0] == 0) {
+      --stored;
+    }
+  }
+  line.cells = static_cast<uint16_t>(stored);
+
+  // codepoints
+  uint8_t size = 1;
+  for (int col = 0; col < stored; ++col) {
+    size = std::max(size, CodepointSize(cells[col].chars[0]));
+  }
+  line.codepoint_size = size;
+  chunk.text.resize(line.text_offset + stored * size);
+  auto p = chunk.text.data() + line.text_offset;
+  for (int col = 0; col < stored; ++col, p += size) {
+    auto codepoint = cells[col].chars[0];
+    if (codepoint == 0) {
+      codepoint = ' ';
+    }
+    switch (size) {
+    case 1:
+      *p = static_cast<uint8_t>(codepoint);
+      break;
+    case 2: {
+      auto value = static_cast<uint16_t>(codepoint);
+      memcpy(p, &value, 2);
+      break;
+    }
+    default:
+      memcpy(p, &codepoint, 4);
+      break;
+    }
+  }
+
+  chunk.lines.push_back(line);
+  // incremental search index
+  codepoints_.resize(stored);
+  for (int col = 0; col < stored; ++col) {
+    codepoints_[col] = cells[col].chars[0];
+  }
+  chunk.index.AddLine(codepoints_);
+  bytes_ += chunk.Bytes() - before;
+  ++size_;
+
+  Evict();
+}
+
+bool Scrollback::Pop(int cols, VTermScreenCell *cells) {
+  if (!size_) {
+    return false;
+  }
+  ++pop_count_;
+
+  auto &chunk = *chunks_.back();
+  auto before = chunk.Bytes();
+  if (chunk.IsCompressed()) {
+    cache_.clear();
+    if (!chunk.Decompress()) {
+      return false;
+    }
+  }
+  ++chunk.generation;
+  chunk.stored_raw = false;
+  auto line = chunk.lines.back();
+  RestoreLine(chunk, line, cols, cells);
+
+  chunk.lines.pop_back();
+  chunk.runs.resize(line.run_offset);
+  chunk.text.resize(line.text_offset);
+  bytes_ -= before;
+  bytes_ += chunk.Bytes();
+  --size_;
+
+  if (chunk.lines.empty() || chunk.EndLine() <= first_line_number_) {
+    RemoveChunk(chunks_.end() - 1);
+  }
+  return true;
+}
+
+void Scrollback::RemoveChunk(
+    std::deque<std::shared_ptr<ScrollbackChunk>>::iterator it) {
+  bytes_ -= (*it)->Bytes();
+  cache_.remove_if([p = it->get()](auto &kv) { return kv.first == p; });
+  chunks_.erase(it);
+}
+
+const ScrollbackChunk *Scrollback::Hot(const ScrollbackChunk *chunk) const {
+  if (!chunk->IsCompressed()) {
+    return chunk;
+  }
+  auto found = std::find_if(cache_.begin(), cache_.end(),
+                            [chunk](auto &kv) { return kv.first == chunk; });
+  if (found != cache_.end()) {
+    cache_.splice(cache_.begin(), cache_, found);
+    return cache_.front().second.get();
+  }
+
+  auto hot = std::make_unique<ScrollbackChunk>(chunk->first_line);
+  std::vector<uint8_t> raw(chunk->raw_size);
+  if (!blockcodec::Decompress(chunk->compressed, raw) ||
+      !hot->Deserialize(raw)) {
+    return nullptr;
+  }
+  cache_.emplace_front(chunk, std::move(hot));
+  if (cache_.size() > 4) {
+    cache_.pop_back();
+  }
+  return cache_.front().second.get();
+}
+
+std::pair<const ScrollbackChunk *, const ScrollbackLine *>
+Scrollback::Find(size_t index) const {
+  if (index >= size_) {
+    return {};
+  }
+  auto line = first_line_number_ + index;
+  auto found = std::upper_bound(
+      chunks_.begin(), chunks_.end(), line,
+      [](uint64_t line, auto &chunk) { return line < chunk->first_line; });
+  auto chunk = Hot((found - 1)->get());
+  if (!chunk) {
+    return {};
+  }
+  return {chunk, &chunk->lines[line - chunk->first_line]};
+}
+
+void Scrollback::GetLine(size_t index, int cols, VTermScreenCell *cells) const {
+  auto [chunk, line] = Find(index);
+  if (!chunk) {
+    for (int col = 0; col < cols; ++col) {
+      cells[col] = {};
+    }
+    return;
+  }
+  RestoreLine(*chunk, *line, cols, cells);
+}
+
+void Scrollback::GetCodepoints(size_t index, std::vector<uint32_t> &out) const {
+  out.clear();
+  auto [chunk, line] = Find(index);
+  if (!chunk) {
+    return;
+  }
+  out.resize(line->cells);
+  for (size_t col = 0; col < line->cells; ++col) {
+    out[col] = chunk->Codepoint(*line, col);
+  }
+}
+
+void Scrollback::Search(
+    const LineMatcher &matcher,
+    const std::function<bool(size_t index, int col, int length)> &on_match)
+    const {
+  // 1 byte lines are searched in place by std::string_view::find, that is
+  // memchr and memcmp (vectorized by libc).
+  auto literal = !matcher.Options().ignore_case && !matcher.Options().regex;
+  std::string narrow;
+  bool narrow_possible = true;
+  // the grapheme cluster bases that Match looks for
+  for (auto c : matcher.FoldedNeedle()) {
+    if (c >= 0x100) {
+      narrow_possible = false;
+      break;
+    }
+    narrow.push_back(static_cast<char>(c));
+  }
+
+  std::vector<uint32_t> codepoints;
+  for (auto &cold : chunks_) {
+    if (matcher.UseIndex() &&
+        !cold->index.MayContain(matcher.IndexNeedle())) {
+      continue;
+    }
+    auto chunk = Hot(cold.get());
+    if (!chunk) {
+      continue;
+    }
+    for (auto n = std::max(chunk->first_line, first_line_number_);
+         n < chunk->EndLine(); ++n) {
+      auto &line = chunk->lines[n - chunk->first_line];
+      auto index = static_cast<size_t>(n - first_line_number_);
+      auto emit = [&on_match, index](int col, int length) {
+        return on_match(index, col, length);
+      };
+
+      if (literal && line.codepoint_size == 1) {
+        if (!narrow_possible) {
+          continue;
+        }
+        std::string_view text(reinterpret_cast<const char *>(
+                                  chunk->text.data() + line.text_offset),
+                              line.cells);
+        for (auto pos = text.find(narrow); pos != text.npos;
+             pos = text.find(narrow, pos + narrow.size())) {
+          if (!emit(static_cast<int>(pos), static_cast<int>(narrow.size()))) {
+            return;
+          }
+        }
+        continue;
+      }
+
+      codepoints.resize(line.cells);
+      for (size_t col = 0; col < line.cells; ++col) {
+        codepoints[col] = chunk->Codepoint(line, col);
+      }
+      if (!matcher.Match(codepoints, emit)) {
+        return;
+      }
+    }
+  }
+}
+
+void Scrollback::Evict() {
+  while (max_lines_ && size_ > max_lines_) {
+    --size_;
+    ++first_line_number_;
+    if (chunks_.front()->EndLine() <= first_line_number_) {
+      RemoveChunk(chunks_.begin());
+    }
+  }
+
+  while (max_bytes_ && bytes_ > max_bytes_ && chunks_.size() > 1) {
+    auto remaining = chunks_.front()->EndLine() - first_line_number_;
+    size_ -= remaining;
+    first_line_number_ += remaining;
+    RemoveChunk(chunks_.begin());
+  }
+}
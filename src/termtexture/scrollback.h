@@ -0,0 +1,166 @@
+#pragma once
+#include "search.h"
+#include <deque>
+#include <list>
+#include <memory>
+#include <span>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include <vterm.h>
+
+/// cells of a line.
+/// codepoint is stored in 1, 2 or 4 bytes by the largest codepoint in the line.
+/// trailing blanks are trimmed and other blanks are stored as space.
+/// combining chars(chars[1...]) are dropped.
+struct ScrollbackLine {
+  // byte offset in ScrollbackChunk::text
+  uint32_t text_offset;
+  // index in ScrollbackChunk::runs
+  uint32_t run_offset;
+  // stored cells
+  uint16_t cells;
+  // width when pushed
+  uint16_t cols;
+  uint16_t run_count;
+  // 1, 2 or 4
+  uint8_t codepoint_size;
+};
+
+struct ScrollbackStyle {
+  uint16_t attrs;
+  VTermColor fg;
+  VTermColor bg;
+
+  bool operator==(const ScrollbackStyle &rhs) const;
+  size_t Hash() const;
+};
+
+/// continuous cells that have same style.
+/// the last run of a line extends to ScrollbackLine::cols.
+struct ScrollbackRun {
+  uint16_t length;
+  // index in ScrollbackChunk::styles
+  uint16_t style;
+};
+
+struct ScrollbackChunk {
+  static const size_t LINES = 1024;
+  static const size_t STYLES = 0xFFFF;
+  // absolute line number of lines[0]
+  uint64_t first_line;
+  std::vector<ScrollbackLine> lines;
+  std::vector<ScrollbackRun> runs;
+  std::vector<ScrollbackStyle> styles;
+  std::vector<uint8_t> text;
+  // style to index. released when sealed, rebuilt by Reopen
+  std::unordered_multimap<size_t, uint16_t> style_map;
+  bool sealed = false;
+  // kept uncompressed. a search can skip a cold chunk without decompressing
+  SearchIndex index;
+
+  // cold tier. lines, runs, styles and text compressed by blockcodec
+  std::vector<uint8_t> compressed;
+  uint32_t compressed_lines = 0;
+  uint32_t raw_size = 0;
+  // incremented when a sealed chunk is modified.
+  // a compression result for an older generation is discarded.
+  uint32_t generation = 0;
+  bool compressing = false;
+  // compressed to no smaller. not tried again until modified
+  bool stored_raw = false;
+
+  ScrollbackChunk(uint64_t first) : first_line(first) {}
+  bool IsCompressed() const { return raw_size != 0; }
+  size_t LineCount() const {
+    return IsCompressed() ? compressed_lines : lines.size();
+  }
+  // serialized size
+  size_t RawSize() const;
+  size_t Bytes() const {
+    return sizeof(index) + (IsCompressed() ? compressed.size() : RawSize());
+  }
+  uint64_t EndLine() const { return first_line + LineCount(); }
+  bool IsFull(int cols) const {
+    return lines.size() >= LINES || styles.size() + cols > STYLES;
+  }
+  uint16_t StyleIndex(const ScrollbackStyle &style);
+  uint32_t Codepoint(const ScrollbackLine &line, size_t col) const;
+  void Seal();
+  // append again after the chunks behind it were popped
+  bool Reopen();
+  std::vector<uint8_t> Serialize() const;
+  bool Deserialize(std::span<const uint8_t> raw);
+  // restore hot tier in place
+  bool Decompress();
+};
+
+struct ScrollbackCompressJob;
+
+/// Lines pushed out of the top of the screen.
+/// Line index 0 is the oldest line.
+///
+/// Sealed chunks older than the last hot_chunks are compressed on a
+/// background thread, and decompressed on demand into a small cache when
+/// read.
+class Scrollback {
+  std::deque<std::shared_ptr<ScrollbackChunk>> chunks_;
+  size_t size_ = 0;
+  size_t bytes_ = 0;
+  // absolute line number of index 0
+  uint64_t first_line_number_ = 0;
+  // a popped line number is reused by the next push
+  uint64_t pop_count_ = 0;
+  size_t max_lines_;
+  size_t max_bytes_;
+
+  bool compression_ = true;
+  size_t hot_chunks_ = 4;
+  std::list<std::shared_ptr<ScrollbackCompressJob>> jobs_;
+  std::function<void()> on_compressed_;
+  // decompressed cold chunks. most recently used first
+  mutable std::list<std::pair<const ScrollbackChunk *,
+                              std::unique_ptr<ScrollbackChunk>>>
+      cache_;
+  std::vector<uint32_t> codepoints_;
+
+public:
+  // 0 is unlimited
+  Scrollback(size_t max_lines = 10000, size_t max_bytes = 0);
+  ~Scrollback();
+  Scrollback(const Scrollback &) = delete;
+  Scrollback &operator=(const Scrollback &) = delete;
+  void SetLimit(size_t max_lines, size_t max_bytes);
+  // keep the last hot_chunks * ScrollbackChunk::LINES lines uncompressed
+  void SetCompression(bool enable, size_t hot_chunks = 4);
+  // called on the worker thread when a chunk is compressed. e.g. wake the
+  // loop that calls Update
+  void SetOnCompressed(const std::function<void()> &on_compressed) {
+    on_compressed_ = on_compressed;
+  }
+  // apply finished background compression
+  void Update();
+  size_t Size() const { return size_; }
+  size_t Bytes() const { return bytes_; }
+  uint64_t FirstLineNumber() const { return first_line_number_; }
+  uint64_t EndLineNumber() const { return first_line_number_ + size_; }
+  uint64_t PopCount() const { return pop_count_; }
+  void Clear();
+  void Push(int cols, const VTermScreenCell *cells);
+  bool Pop(int cols, VTermScreenCell *cells);
+  void GetLine(size_t index, int cols, VTermScreenCell *cells) const;
+  // codepoint per cell. trailing blanks are not included
+  void GetCodepoints(size_t index, std::vector<uint32_t> &out) const;
+  // from oldest to newest. return false from on_match to stop
+  void Search(const LineMatcher &matcher,
+              const std::function<bool(size_t index, int col, int length)>
+                  &on_match) const;
+
+private:
+  std::pair<const ScrollbackChunk *, const ScrollbackLine *>
+  Find(size_t index) const;
+  void Evict();
+  void RemoveChunk(std::deque<std::shared_ptr<ScrollbackChunk>>::iterator it);
+  void ScheduleCompress();
+  const ScrollbackChunk *Hot(const ScrollbackChunk *chunk) const;
+};
@@ -0,0 +1,197 @@
+#include "search.h"
+#include "unicode.h"
+#include <regex>
+#include <vector>
+
+struct LineRegex {
+  std::regex regex;
+};
+
+std::u32string Utf8ToCodepoints(std::string_view utf8) {
+  std::u32string out;
+  for (size_t i = 0; i < utf8.size();) {
+    uint8_t c = utf8[i];
+    int extra = 0;
+    uint32_t codepoint = c;
+    if (c >= 0xF0) {
+      extra = 3;
+      codepoint = c & 0x07;
+    } else if (c >= 0xE0) {
+      extra = 2;
+      codepoint = c & 0x0F;
+    } else if (c >= 0xC0) {
+      extra = 1;
+      codepoint = c & 0x1F;
+    } else if (c >= 0x80) {
+      // stray continuation byte
+      out.push_back(0xFFFD);
+      ++i;
+      continue;
+    }
+    ++i;
+    for (; extra > 0 && i < utf8.size(); --extra, ++i) {
+      codepoint = codepoint << 6 | (utf8[i] & 0x3F);
+    }
+    out.push_back(extra ? 0xFFFD : codepoint);
+  }
+  return out;
+}
+
+void AppendUtf8(std::string &out, uint32_t codepoint) {
+  if (codepoint < 0x80) {
+    out.push_back(static_cast<char>(codepoint));
+  } else if (codepoint < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | codepoint >> 6));
+    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  } else if (codepoint < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | codepoint >> 12));
+    out.push_back(static_cast<char>(0x80 | (codepoint >> 6 & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | codepoint >> 18));
+    out.push_back(static_cast<char>(0x80 | (codepoint >> 12 & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (codepoint >> 6 & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  }
+}
+
+//
+// SearchIndex
+//
+void SearchIndex::AddLine(std::span<const uint32_t> codepoints) {
+  uint32_t prev = 0;
+  bool has_prev = false;
+  for (auto codepoint : codepoints) {
+    if (codepoint == CONTINUATION_CODEPOINT) {
+      continue;
+    }
+    if (codepoint == 0) {
+      codepoint = ' ';
+    }
+    codepoint = FoldCase(codepoint);
+    Set(UnigramHash(codepoint));
+    if (has_prev) {
+      Set(BigramHash(prev, codepoint));
+    }
+    prev = codepoint;
+    has_prev = true;
+  }
+}
+
+bool SearchIndex::MayContain(std::u32string_view folded_needle) const {
+  for (size_t i = 0; i < folded_needle.size(); ++i) {
+    if (!Get(UnigramHash(folded_needle[i]))) {
+      return false;
+    }
+    if (i && !Get(BigramHash(folded_needle[i - 1], folded_needle[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// LineMatcher
+//
+LineMatcher::LineMatcher(std::u32string_view needle,
+                         const SearchOptions &options)
+    : needle_(needle), folded_(needle), options_(options) {
+  if (options_.ignore_case) {
+    for (auto &c : folded_) {
+      c = FoldCase(c);
+    }
+  }
+  // a cell keeps the first codepoint of its grapheme cluster. so does the
+  // needle. e.g. e + U+0301 finds the cell of e with the combining accent
+  std::u32string bases;
+  for (size_t pos = 0; pos < folded_.size();
+       pos = NextGraphemeBoundary(folded_, pos)) {
+    bases.push_back(folded_[pos]);
+  }
+  folded_ = std::move(bases);
+  index_needle_ = folded_;
+  for (auto &c : index_needle_) {
+    c = FoldCase(c);
+  }
+}
+
+LineMatcher::~LineMatcher() {}
+
+std::shared_ptr<LineMatcher> LineMatcher::Create(std::string_view utf8,
+                                                 const SearchOptions &options) {
+  if (utf8.empty()) {
+    return nullptr;
+  }
+  auto ptr = std::shared_ptr<LineMatcher>(
+      new LineMatcher(Utf8ToCodepoints(utf8), options));
+  if (options.regex) {
+    auto flags = std::regex::ECMAScript | std::regex::optimize;
+    if (options.ignore_case) {
+      flags |= std::regex::icase;
+    }
+    try {
+      ptr->regex_ = std::make_unique<LineRegex>(
+          LineRegex{std::regex(utf8.begin(), utf8.end(), flags)});
+    } catch (const std::regex_error &) {
+      return nullptr;
+    }
+  }
+  return ptr;
+}
+
+bool LineMatcher::Match(
+    std::span<const uint32_t> cells,
+    const std::function<bool(int col, int length)> &on_match) const {
+  // drop the right half of wide chars
+  std::u32string text;
+  std::vector<int> cols;
+  text.reserve(cells.size());
+  cols.reserve(cells.size() + 1);
+  for (size_t col = 0; col < cells.size(); ++col) {
+    auto codepoint = cells[col];
+    if (codepoint == CONTINUATION_CODEPOINT) {
+      continue;
+    }
+    if (codepoint == 0) {
+      codepoint = ' ';
+    }
+    if (options_.ignore_case && !regex_) {
+      codepoint = FoldCase(codepoint);
+    }
+    text.push_back(codepoint);
+    cols.push_back(static_cast<int>(col));
+  }
+  cols.push_back(static_cast<int>(cells.size()));
+
+  if (!regex_) {
+    std::u32string_view view(text);
+    for (auto pos = view.find(folded_); pos != view.npos;
+         pos = view.find(folded_, pos + folded_.size())) {
+      if (!on_match(cols[pos], cols[pos + folded_.size()] - cols[pos])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::string utf8;
+  std::vector<size_t> index_from_byte;
+  for (size_t i = 0; i < text.size(); ++i) {
+    AppendUtf8(utf8, text[i]);
+    index_from_byte.resize(utf8.size(), i);
+  }
+  index_from_byte.push_back(text.size());
+  for (auto it = std::sregex_iterator(utf8.begin(), utf8.end(), regex_->regex);
+       it != std::sregex_iterator(); ++it) {
+    auto &m = *it;
+    if (m.length() == 0) {
+      continue;
+    }
+    auto begin = index_from_byte[m.position()];
+    auto end = index_from_byte[m.position() + m.length()];
+    if (!on_match(cols[begin], cols[end] - cols[begin])) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "celltypes.h"
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+// chars[0] of the right half of a wide char
+const uint32_t CONTINUATION_CODEPOINT = 0xFFFFFFFF;
+
+inline uint32_t FoldCase(uint32_t codepoint) {
+  if (codepoint >= 'A' && codepoint <= 'Z') {
+    return codepoint + ('a' - 'A');
+  }
+  return codepoint;
+}
+
+/// Bits of codepoint unigrams and bigrams (case folded).
+/// A line set that does not have all bits of a needle can not contain it.
+struct SearchIndex {
+  static const size_t BITS = 8192;
+  uint64_t bits[BITS / 64] = {};
+
+  static size_t UnigramHash(uint32_t a) {
+    return (a * 0x9E3779B1u) >> 19;
+  }
+  static size_t BigramHash(uint32_t a, uint32_t b) {
+    return ((a * 31 + b) * 0x85EBCA6Bu) >> 19;
+  }
+  void Set(size_t hash) { bits[hash / 64] |= 1ull << (hash % 64); }
+  bool Get(size_t hash) const { return bits[hash / 64] & (1ull << (hash % 64)); }
+  void AddLine(std::span<const uint32_t> codepoints);
+  bool MayContain(std::u32string_view folded_needle) const;
+};
+
+/// Finds a pattern in a line of cells.
+class LineMatcher {
+  std::u32string needle_;
+  std::u32string folded_;
+  // folded_ case folded also for a case sensitive search, as SearchIndex is
+  std::u32string index_needle_;
+  SearchOptions options_;
+  std::unique_ptr<struct LineRegex> regex_;
+
+  LineMatcher(std::u32string_view needle, const SearchOptions &options);
+
+public:
+  ~LineMatcher();
+  LineMatcher(const LineMatcher &) = delete;
+  LineMatcher &operator=(const LineMatcher &) = delete;
+  // nullptr if pattern is empty or regex is invalid
+  static std::shared_ptr<LineMatcher> Create(std::string_view utf8,
+                                             const SearchOptions &options);
+  const SearchOptions &Options() const { return options_; }
+  const std::u32string &Needle() const { return needle_; }
+  // first codepoint of each grapheme cluster, case folded for ignore_case.
+  // what Match looks for
+  const std::u32string &FoldedNeedle() const { return folded_; }
+  // for SearchIndex::MayContain
+  const std::u32string &IndexNeedle() const { return index_needle_; }
+  bool UseIndex() const { return !options_.regex; }
+  // one codepoint per cell. return false from on_match to stop
+  bool Match(std::span<const uint32_t> cells,
+             const std::function<bool(int col, int length)> &on_match) const;
+};
+
+std::u32string Utf8ToCodepoints(std::string_view utf8);
+void AppendUtf8(std::string &out, uint32_t codepoint);
@@ -2,9 +2,22 @@
 #include "cellgrid.h"
 #include "celltypes.h"
 #include "common_pty.h"
+#include "cpu_rasterizer.h"
 #include "cursor.h"
+#include "frame_stats.h"
+#include "gl_batch.h"
+#include "gl_backend.h"
+#include "pty_record.h"
+#include "pty_sessions.h"
+#include "pty_write_queue.h"
+#include "search.h"
+#include "trace.h"
 #include "vterm_object.h"
+#include <algorithm>
+#include <glo/fbo.h>
+#include <glo/readback.h>
 #include <memory>
+#include <optional>
 
 namespace termtexture {
 
@@ -19,21 +32,99 @@ class TermTextureImpl {
       .cols = 80,
   };
   std::shared_ptr<Cursor> cursor_;
+  std::shared_ptr<CpuRasterizer> cpu_;
+  std::shared_ptr<GlBatchBackend> batch_;
+  // scrollback line number next to the last line at the previous frame
+  uint64_t history_end_ = 0;
+  uint64_t pop_count_ = 0;
+  std::shared_ptr<PtyRecorder> recorder_;
+  std::shared_ptr<PtyRecording> replay_;
+  bool replay_realtime_ = true;
+  std::chrono::steady_clock::time_point replay_start_;
+  // the recorded size instead of the texture size. not realtime
+  std::optional<TermSize> replay_size_;
+  // headless
+  std::shared_ptr<glo::FboRenderer> offscreen_;
+  std::shared_ptr<glo::PixelReader> reader_;
+  FrameStats stats_;
+  std::function<void()> wake_;
+
+  // key to present
+  // a key without echo, e.g. a password prompt, is dropped after this
+  static constexpr std::chrono::seconds ECHO_TIMEOUT{1};
+  bool low_latency_ = false;
+  std::chrono::microseconds echo_wait_{};
+  // the first key not echoed yet
+  std::optional<std::chrono::steady_clock::time_point> key_time_;
+  bool echoed_ = false;
+  bool echo_rendered_ = false;
+
+  // vterm output goes here instead of the pty
+  std::string *capture_ = nullptr;
 
 public:
-  common_pty::Pty pty_;
+  // changed since the last Render without pty output. e.g. scroll
+  bool dirty_ = true;
+  // rows scrolled back into the scrollback. fractional for smooth scroll
+  double scroll_ = 0;
+  // replaced by a PtySessions pty on Launch
+  std::shared_ptr<common_pty::Pty> pty_;
   std::shared_ptr<VTermObject> vterm_;
   TermTextureImpl() {
     grid_ = CellGrid::Create();
+    pty_ = std::make_shared<common_pty::Pty>();
     vterm_ = std::shared_ptr<VTermObject>(new VTermObject(
         size_.rows, size_.cols,
         [](const char *s, size_t len, void *user) {
-          ((common_pty::Pty *)user)->Write(s, len);
+          ((TermTextureImpl *)user)->Output(s, len);
         },
-        &pty_));
+        this));
     cursor_ = Cursor::Create();
   }
 
+  void Output(const char *s, size_t len) {
+    if (capture_) {
+      capture_->append(s, len);
+    } else {
+      pty_->Write(s, len);
+    }
+  }
+
+  std::shared_ptr<common_pty::WriteStream> Paste(std::string_view text) {
+    std::string begin;
+    std::string end;
+    capture_ = &begin;
+    vterm_->keyboard_start_paste();
+    capture_ = &end;
+    vterm_->keyboard_end_paste();
+    capture_ = nullptr;
+
+    // a pasted line ends with CR like the enter key.
+    // ESC and C1 controls are dropped. an embedded ESC [ 201 ~ would end the
+    // bracketed paste and the rest would run as typed
+    auto data = begin;
+    data.reserve(begin.size() + text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+      uint8_t c = text[i];
+      if (c == '\r' && i + 1 < text.size() && text[i + 1] == '\n') {
+        continue;
+      }
+      if (c == 0x1B) {
+        continue;
+      }
+      // U+0080-U+009F in UTF-8
+      if (c == 0xC2 && i + 1 < text.size()) {
+        uint8_t next = text[i + 1];
+        if (next >= 0x80 && next < 0xA0) {
+          ++i;
+          continue;
+        }
+      }
+      data.push_back(c == '\n' ? '\r' : text[i]);
+    }
+    return pty_->StreamWrite(std::move(data), std::move(end));
+  }
+
   TermSize TermSizeFromTextureSize(PixelSize screen_size) const {
     auto cols = std::max(1, screen_size.width / cell_size_.width);
     auto rows = std::max(1, screen_size.height / cell_size_.height);
@@ -41,59 +132,406 @@ public:
   }
 
   void UpdateTextureSize(PixelSize screen_size) {
-    auto size = TermSizeFromTextureSize(screen_size);
+    ResizeTerm(replay_size_ ? *replay_size_
+                            : TermSizeFromTextureSize(screen_size));
+    grid_->Resize(size_.rows, size_.cols);
+  }
+
+  void ResizeTerm(TermSize size) {
     if (size == size_) {
       return;
     }
-    // resize
     size_ = size;
-    pty_.NotifyTermSize(size_.rows, size_.cols);
+    pty_->NotifyTermSize(size_.rows, size_.cols);
+    if (recorder_) {
+      recorder_->Resize(size_.rows, size_.cols);
+    }
     vterm_->resize_rows_cols(size_.rows, size_.cols);
-    grid_->Clear();
   }
 
-  bool LoadFont(std::string_view fontfile, PixelSize cell_size) {
+  bool LoadFont(std::string_view fontfile, PixelSize cell_size,
+                std::shared_ptr<GlRenderContext> context) {
+    if (!context) {
+      context = GlRenderContext::Create();
+      if (!context) {
+        return false;
+      }
+    }
+    auto atlas = context->LoadFont(fontfile, cell_size, 1024);
+    if (!atlas) {
+      return false;
+    }
+    auto backend = GlBackend::Create(context);
+    if (!backend) {
+      return false;
+    }
+    backend->SetStats(&stats_);
+    grid_->SetBackend(backend);
+    batch_ = nullptr;
     cell_size_ = cell_size;
-    return grid_->Load(fontfile, cell_size, 1024);
+    return grid_->SetAtlas(atlas, cell_size);
   }
 
   void Launch(TermSize size, const char *cmd) {
     size_ = size;
     vterm_->resize_rows_cols(size_.rows, size_.cols);
-    pty_.Launch(size_.rows, size_.cols, cmd);
+    if (wake_) {
+      pty_->SetOnOutput(wake_);
+    }
+    pty_->Launch(size_.rows, size_.cols, cmd);
   }
 
-  void Render(PixelSize size, std::chrono::nanoseconds duration) {
+  bool Launch(TermSize size, const char *cmd,
+              const std::shared_ptr<PtySessions> &sessions, void *user) {
+    auto pty = sessions->Launch(size.rows, size.cols, cmd, user);
+    if (!pty) {
+      return false;
+    }
+    size_ = size;
+    vterm_->resize_rows_cols(size_.rows, size_.cols);
+    pty_ = pty;
+    return true;
+  }
+
+  std::vector<SearchMatch> Search(std::string_view pattern,
+                                  const SearchOptions &options) const {
+    std::vector<SearchMatch> matches;
+    auto matcher = LineMatcher::Create(pattern, options);
+    if (!matcher) {
+      return matches;
+    }
+
+    auto &scrollback = vterm_->scrollback();
+    auto scrollback_size = static_cast<int64_t>(scrollback.Size());
+    scrollback.Search(*matcher, [&](size_t index, int col, int length) {
+      matches.push_back({
+          .row = static_cast<int64_t>(index) - scrollback_size,
+          .col = col,
+          .length = length,
+      });
+      return matches.size() < options.max_results;
+    });
+
+    std::vector<uint32_t> codepoints;
+    for (int row = 0;
+         row < size_.rows && matches.size() < options.max_results; ++row) {
+      vterm_->get_codepoints(row, codepoints);
+      matcher->Match(codepoints, [&](int col, int length) {
+        matches.push_back({.row = row, .col = col, .length = length});
+        return matches.size() < options.max_results;
+      });
+    }
+    return matches;
+  }
+
+  void RenderOffscreen(PixelSize size, std::chrono::nanoseconds duration) {
+    if (!offscreen_) {
+      offscreen_ = std::make_shared<glo::FboRenderer>(false);
+      reader_ = glo::PixelReader::Create();
+    }
+    float clear_color[] = {0, 0, 0, 1};
+    auto region = offscreen_->Begin(size.width, size.height, clear_color);
+    if (!region.texture) {
+      return;
+    }
+    Render(size, duration);
+    reader_->Read(0, 0, size.width, size.height);
+    offscreen_->End();
+  }
+
+  bool ReadPixels(std::vector<uint8_t> &rgba, int *width, int *height,
+                  bool wait) {
+    if (!reader_) {
+      return false;
+    }
+    return reader_->TryGet(rgba, width, height, wait);
+  }
+
+  void Scroll(double rows) {
+    auto scroll = std::clamp(scroll_ + rows, 0.0,
+                             static_cast<double>(vterm_->scrollback().Size()));
+    if (scroll != scroll_) {
+      scroll_ = scroll;
+      dirty_ = true;
+    }
+  }
+
+  void SetWake(const std::function<void()> &wake) {
+    wake_ = wake;
+    // Poll applies the compressed chunk after the output stopped
+    vterm_->scrollback().SetOnCompressed(wake);
+  }
+
+  bool StartRecording(std::string_view path) {
+    recorder_ = PtyRecorder::Create(path, size_.rows, size_.cols);
+    return recorder_ != nullptr;
+  }
+
+  void StopRecording() { recorder_ = nullptr; }
+
+  bool StartReplay(std::string_view path, bool realtime) {
+    replay_ = PtyRecording::Open(path);
+    replay_realtime_ = realtime;
+    replay_start_ = std::chrono::steady_clock::now();
+    replay_size_.reset();
+    if (!replay_) {
+      return false;
+    }
+    if (!realtime) {
+      ReplayResize(replay_->Rows(), replay_->Cols());
+    }
+    return true;
+  }
+
+  bool IsReplaying() const {
+    std::chrono::nanoseconds time;
+    return replay_ && replay_->NextTime(&time);
+  }
+
+  void ReplayResize(int rows, int cols) {
+    replay_size_ = TermSize{
+        .rows = static_cast<uint16_t>(rows),
+        .cols = static_cast<uint16_t>(cols),
+    };
+    // before the output that follows
+    ResizeTerm(*replay_size_);
+  }
+
+  // recording to vterm. resize events are applied only without realtime, a
+  // realtime replay follows the texture size. true if any output was fed
+  bool Replay() {
+    bool fed = false;
+    PtyEvent event;
+    if (replay_realtime_) {
+      auto now = std::chrono::steady_clock::now() - replay_start_;
+      std::chrono::nanoseconds time;
+      while (replay_->NextTime(&time) && time <= now && replay_->Next(&event)) {
+        if (event.kind == PtyEventKind::Output) {
+          vterm_->input_write(event.bytes.data(), event.bytes.size());
+          fed = true;
+        }
+      }
+    } else {
+      // one recorded read per frame. the same batches as the capture
+      while (replay_->Next(&event)) {
+        if (event.kind == PtyEventKind::Resize) {
+          ReplayResize(event.rows, event.cols);
+        } else if (event.kind == PtyEventKind::Output) {
+          vterm_->input_write(event.bytes.data(), event.bytes.size());
+          fed = true;
+          break;
+        }
+      }
+    }
+    return fed;
+  }
+
+  // pty to vterm. true if any output was fed
+  bool Drain() {
+    if (replay_) {
+      ScopedStageTimer stage(&stats_, FrameStage::Parse);
+      return Replay();
+    }
+
+    std::span<char> input;
+    {
+      ScopedStageTimer stage(&stats_, FrameStage::PtyDrain);
+      input = pty_->Read();
+      if (recorder_ && !input.empty()) {
+        recorder_->Output(input);
+      }
+    }
+    if (input.empty()) {
+      return false;
+    }
+    if (key_time_ && !echoed_) {
+      if (std::chrono::steady_clock::now() - *key_time_ > ECHO_TIMEOUT) {
+        ResetKey();
+      } else {
+        echoed_ = true;
+      }
+    }
+    ScopedStageTimer stage(&stats_, FrameStage::Parse);
+    vterm_->input_write(input.data(), input.size());
+    return true;
+  }
+
+  void ResetKey() {
+    key_time_ = {};
+    echoed_ = false;
+    echo_rendered_ = false;
+  }
+
+  void OnKey() {
+    auto now = std::chrono::steady_clock::now();
+    if (key_time_ && now - *key_time_ > ECHO_TIMEOUT) {
+      ResetKey();
+    }
+    if (!key_time_) {
+      key_time_ = now;
+    }
+  }
+
+  void SetLowLatency(bool enable, std::chrono::microseconds echo_wait) {
+    low_latency_ = enable;
+    echo_wait_ = echo_wait;
+  }
+
+  void Presented() {
+    if (!echo_rendered_) {
+      return;
+    }
+    stats_.AddSample(FrameStage::KeyToPresent,
+                     std::chrono::steady_clock::now() - *key_time_);
+    ResetKey();
+  }
+
+  bool Poll() {
+    if (low_latency_ && key_time_ && !echoed_ && !replay_) {
+      // the child usually echoes within a few hundred microseconds. render
+      // the echo in this frame instead of the next wake
+      auto remaining =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              *key_time_ + echo_wait_ - std::chrono::steady_clock::now());
+      if (remaining.count() > 0) {
+        pty_->WaitOutput(remaining);
+      }
+    }
+    if (Drain()) {
+      dirty_ = true;
+    }
+    // frees the hot tier of chunks compressed since. nothing to draw
+    vterm_->scrollback().Update();
+    return dirty_;
+  }
 
+  const PosSet &Update(PixelSize size) {
     UpdateTextureSize(size);
+    Drain();
+    // a replayed resize
+    grid_->Resize(size_.rows, size_.cols);
 
-    // pty to vterm
-    auto input = pty_.Read();
-    if (!input.empty()) {
-      vterm_->input_write(input.data(), input.size());
+    ScopedStageTimer stage(&stats_, FrameStage::DamageWalk);
+    bool ringing;
+    return vterm_->new_frame(&ringing, true);
+  }
+
+  const FrameStats &Stats() const { return stats_; }
+
+  bool LoadBatchFont(std::string_view fontfile, PixelSize cell_size,
+                     const std::shared_ptr<GlBatch> &batch) {
+    auto atlas = batch->Context()->LoadFont(fontfile, cell_size, 1024);
+    if (!atlas) {
+      return false;
+    }
+    auto backend = batch->CreateBackend();
+    if (!backend) {
+      return false;
+    }
+    backend->SetStats(&stats_);
+    grid_->SetBackend(backend);
+    cell_size_ = cell_size;
+    if (!grid_->SetAtlas(atlas, cell_size)) {
+      return false;
+    }
+    batch_ = backend;
+    return true;
+  }
+
+  void RenderBatched(int x, int y, PixelSize size,
+                     std::chrono::nanoseconds duration) {
+    if (!batch_) {
+      return;
+    }
+    batch_->SetOrigin(x, y);
+    Render(size, duration);
+  }
+
+  bool LoadCpuFont(std::string_view fontfile, PixelSize cell_size) {
+    auto cpu = CpuRasterizer::Create();
+    cpu->SetStats(&stats_);
+    grid_->SetBackend(cpu);
+    batch_ = nullptr;
+    cell_size_ = cell_size;
+    if (!grid_->Load(fontfile, cell_size, 1024)) {
+      return false;
+    }
+    cpu_ = cpu;
+    return true;
+  }
+
+  std::span<const uint8_t> RenderCpu(PixelSize size) {
+    if (!cpu_) {
+      return {};
+    }
+    Render(size, {});
+    return cpu_->Pixels();
+  }
+
+  void Render(PixelSize size, std::chrono::nanoseconds duration) {
+    TRACE_SCOPE("TermTexture::Render");
+    {
+      ScopedStageTimer stage(&stats_, FrameStage::Frame);
+      RenderFrame(size, duration);
     }
+    stats_.EndFrame();
+    dirty_ = false;
+    if (echoed_) {
+      echo_rendered_ = true;
+    }
+  }
 
+  void RenderFrame(PixelSize size, std::chrono::nanoseconds duration) {
     // vterm to screen
-    bool ringing;
-    auto &damaged = vterm_->new_frame(&ringing, true);
+    auto &damaged = Update(size);
     if (!damaged.empty()) {
-      for (auto &pos : damaged) {
-        if (auto cell = vterm_->get_cell(pos)) {
-          grid_->SetCell(
-              {
-                  .row = (uint16_t)pos.row,
-                  .col = (uint16_t)pos.col,
-              },
-              *cell);
+      {
+        ScopedStageTimer stage(&stats_, FrameStage::CellConvert);
+        for (auto &pos : damaged) {
+          if (auto cell = vterm_->get_cell(pos)) {
+            grid_->SetCell(
+                {
+                    .row = (uint16_t)pos.row,
+                    .col = (uint16_t)pos.col,
+                },
+                *cell);
+          }
         }
       }
       grid_->Commit();
     }
 
+    // scrollback to history ring
+    auto &scrollback = vterm_->scrollback();
+    scrollback.Update();
+    if (scrollback.PopCount() != pop_count_) {
+      pop_count_ = scrollback.PopCount();
+      grid_->InvalidateHistory();
+    }
+    auto history_end = scrollback.EndLineNumber();
+    if (scroll_ > 0) {
+      // keep the view while new lines are pushed
+      scroll_ += static_cast<double>(history_end) -
+                 static_cast<double>(history_end_);
+    }
+    history_end_ = history_end;
+    Scroll(0);
+    grid_->SetScroll(history_end, scroll_, size_.rows, size_.cols,
+                     [&](uint64_t line, std::vector<VTermScreenCell> &cells) {
+                       vterm_->get_scrollback_line(
+                           line - scrollback.FirstLineNumber(), size_.cols,
+                           cells);
+                     });
+
     grid_->Render(size, duration);
 
+    if (scroll_ > 0) {
+      // the cursor is out of the view
+      return;
+    }
     if (auto cursor = vterm_->get_cursor()) {
-      cursor_->Render(cursor.value(), size, grid_->CellSize());
+      cursor_->Render(*grid_->Backend(), cursor.value(), size,
+                      grid_->CellSize());
     }
   }
 };
@@ -113,8 +551,9 @@ TermSize TermTexture::TermSizeFromTextureSize(int width, int height) const {
   });
 }
 
-bool TermTexture::LoadFont(std::string_view fontfile, PixelSize cell_size) {
-  return impl_->LoadFont(fontfile, cell_size);
+bool TermTexture::LoadFont(std::string_view fontfile, PixelSize cell_size,
+                           const std::shared_ptr<GlRenderContext> &context) {
+  return impl_->LoadFont(fontfile, cell_size, context);
 }
 
 bool TermTexture::Launch(const char *cmd, TermSize size) {
@@ -122,6 +561,11 @@ bool TermTexture::Launch(const char *cmd, TermSize size) {
   return true;
 }
 
+bool TermTexture::Launch(const std::shared_ptr<PtySessions> &sessions,
+                         const char *cmd, TermSize size) {
+  return impl_->Launch(size, cmd, sessions, this);
+}
+
 void TermTexture::Render(int width, int height,
                          std::chrono::nanoseconds duration) {
   impl_->Render(
@@ -132,14 +576,134 @@ void TermTexture::Render(int width, int height,
       duration);
 }
 
+void TermTexture::RenderOffscreen(int width, int height,
+                                  std::chrono::nanoseconds duration) {
+  impl_->RenderOffscreen(
+      {
+          .width = static_cast<uint16_t>(width),
+          .height = static_cast<uint16_t>(height),
+      },
+      duration);
+}
+
+bool TermTexture::ReadPixels(std::vector<uint8_t> &rgba, int *width,
+                             int *height, bool wait) {
+  return impl_->ReadPixels(rgba, width, height, wait);
+}
+
+void TermTexture::InputWrite(const char *bytes, size_t len) {
+  impl_->vterm_->input_write(bytes, len);
+  impl_->dirty_ = true;
+}
+
+void TermTexture::Resize(int width, int height) {
+  impl_->UpdateTextureSize({
+      .width = static_cast<uint16_t>(width),
+      .height = static_cast<uint16_t>(height),
+  });
+}
+
+bool TermTexture::LoadCpuFont(std::string_view fontfile, PixelSize cell_size) {
+  return impl_->LoadCpuFont(fontfile, cell_size);
+}
+
+bool TermTexture::LoadBatchFont(std::string_view fontfile,
+                                PixelSize cell_size,
+                                const std::shared_ptr<GlBatch> &batch) {
+  return impl_->LoadBatchFont(fontfile, cell_size, batch);
+}
+
+void TermTexture::RenderBatched(int x, int y, int width, int height,
+                                std::chrono::nanoseconds duration) {
+  impl_->RenderBatched(x, y,
+                       {
+                           .width = static_cast<uint16_t>(width),
+                           .height = static_cast<uint16_t>(height),
+                       },
+                       duration);
+}
+
+std::span<const uint8_t> TermTexture::RenderCpu(int width, int height) {
+  return impl_->RenderCpu({
+      .width = static_cast<uint16_t>(width),
+      .height = static_cast<uint16_t>(height),
+  });
+}
+
+bool TermTexture::StartRecording(std::string_view path) {
+  return impl_->StartRecording(path);
+}
+
+void TermTexture::StopRecording() { impl_->StopRecording(); }
+
+bool TermTexture::StartReplay(std::string_view path, bool realtime) {
+  return impl_->StartReplay(path, realtime);
+}
+
+bool TermTexture::IsReplaying() const { return impl_->IsReplaying(); }
+
+void TermTexture::SetScrollbackLimit(size_t max_lines, size_t max_bytes) {
+  impl_->vterm_->scrollback().SetLimit(max_lines, max_bytes);
+}
+
+void TermTexture::SetScrollbackCompression(bool enable, size_t hot_lines) {
+  impl_->vterm_->scrollback().SetCompression(
+      enable, (hot_lines + ScrollbackChunk::LINES - 1) / ScrollbackChunk::LINES);
+}
+
+size_t TermTexture::ScrollbackSize() const {
+  return impl_->vterm_->scrollback().Size();
+}
+
+std::vector<SearchMatch> TermTexture::Search(std::string_view pattern,
+                                             const SearchOptions &options) const {
+  return impl_->Search(pattern, options);
+}
+
+void TermTexture::Scroll(double rows) { impl_->Scroll(rows); }
+
+void TermTexture::ScrollToBottom() {
+  if (impl_->scroll_ != 0) {
+    impl_->scroll_ = 0;
+    impl_->dirty_ = true;
+  }
+}
+
+const FrameStats &TermTexture::Stats() const { return impl_->Stats(); }
+
+double TermTexture::ScrollPosition() const { return impl_->scroll_; }
+
 void TermTexture::KeyboardUnichar(char c, VTermModifier mod) {
+  ScrollToBottom();
+  impl_->OnKey();
   impl_->vterm_->keyboard_unichar(c, mod);
 }
 
 void TermTexture::KeyboardKey(VTermKey key, VTermModifier mod) {
+  ScrollToBottom();
+  impl_->OnKey();
   impl_->vterm_->keyboard_key(key, mod);
 }
 
-bool TermTexture::IsClosed() const { return impl_->pty_.IsClosed(); }
+void TermTexture::SetWake(const std::function<void()> &wake) {
+  impl_->SetWake(wake);
+}
+
+bool TermTexture::Poll() { return impl_->Poll(); }
+
+void TermTexture::SetLowLatency(bool enable,
+                                std::chrono::microseconds echo_wait) {
+  impl_->SetLowLatency(enable, echo_wait);
+}
+
+void TermTexture::Presented() { impl_->Presented(); }
+
+std::shared_ptr<common_pty::WriteStream>
+TermTexture::Paste(std::string_view text) {
+  ScrollToBottom();
+  return impl_->Paste(text);
+}
+
+bool TermTexture::IsClosed() const { return impl_->pty_->IsClosed(); }
 
 } // namespace termtexture
@@ -1,11 +1,27 @@
 #pragma once
 
 #include "celltypes.h"
+#include "frame_stats.h"
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <span>
+#include <stdint.h>
 #include <string_view>
+#include <vector>
 #include <vterm.h>
 
+// see gl_backend.h
+class GlRenderContext;
+// see gl_batch.h
+class GlBatch;
+// see pty_sessions.h
+class PtySessions;
+// see pty_write_queue.h
+namespace common_pty {
+class WriteStream;
+}
+
 namespace termtexture {
 
 struct TermSize {
@@ -26,12 +42,85 @@ public:
   TermTexture &operator=(const TermTexture &) = delete;
   static std::shared_ptr<TermTexture> Create();
   TermSize TermSizeFromTextureSize(int width, int height) const;
-  bool LoadFont(std::string_view fontfile, PixelSize cell_size);
+  // terminals created with the same context share the programs, and the
+  // atlas and glyph table of the same font and cell size.
+  // nullptr uses a context of this terminal only
+  bool LoadFont(std::string_view fontfile, PixelSize cell_size,
+                const std::shared_ptr<GlRenderContext> &context = nullptr);
+  // draw with other terminals of the batch in one call. the font comes from
+  // the batch context
+  bool LoadBatchFont(std::string_view fontfile, PixelSize cell_size,
+                     const std::shared_ptr<GlBatch> &batch);
+  // update the cells at x, y of the batch target. GlBatch::Draw draws
+  void RenderBatched(int x, int y, int width, int height,
+                     std::chrono::nanoseconds duration);
   bool Launch(const char *cmd, TermSize size = {.rows = 24, .cols = 80});
+  // the pty is polled by the sessions instead of a reader thread.
+  // PtySessions::TakeReady reports this TermTexture
+  bool Launch(const std::shared_ptr<PtySessions> &sessions, const char *cmd,
+              TermSize size = {.rows = 24, .cols = 80});
   void Render(int width, int height, std::chrono::nanoseconds duration);
+  // render into an offscreen fbo and queue an asynchronous readback.
+  // needs only a current GL context, e.g. HeadlessContext
+  void RenderOffscreen(int width, int height,
+                       std::chrono::nanoseconds duration);
+  // RGBA8 of the oldest finished RenderOffscreen. rows are bottom to top.
+  // false if none is ready
+  bool ReadPixels(std::vector<uint8_t> &rgba, int *width, int *height,
+                  bool wait = false);
+  // feed bytes to the terminal as if they were read from the pty
+  void InputWrite(const char *bytes, size_t len);
+  // fit the terminal to the texture size before the first render
+  void Resize(int width, int height);
+  // draw on the CPU instead of GL. no GL context is needed
+  bool LoadCpuFont(std::string_view fontfile, PixelSize cell_size);
+  // RGBA8 of cols * cell width x rows * cell height. rows are top to bottom.
+  // only changed rows are redrawn
+  std::span<const uint8_t> RenderCpu(int width, int height);
+  // record the pty output with timestamps. see pty_record.h
+  bool StartRecording(std::string_view path);
+  void StopRecording();
+  // feed a recording instead of the pty. realtime keeps the recorded pacing
+  // and the terminal follows the texture size. otherwise each Render feeds the
+  // next recorded read, and the terminal takes the recorded sizes
+  bool StartReplay(std::string_view path, bool realtime = true);
+  // a replay has events left
+  bool IsReplaying() const;
+  // 0 is unlimited
+  void SetScrollbackLimit(size_t max_lines, size_t max_bytes = 0);
+  // compress scrollback older than hot_lines in background
+  void SetScrollbackCompression(bool enable, size_t hot_lines = 4096);
+  size_t ScrollbackSize() const;
+  // find pattern in the screen and the scrollback
+  std::vector<SearchMatch> Search(std::string_view pattern,
+                                  const SearchOptions &options = {}) const;
+  // rows back into the scrollback. fractional rows scroll by pixels
+  void Scroll(double rows);
+  void ScrollToBottom();
+  double ScrollPosition() const;
+  // rolling per-stage timings of Render
+  const FrameStats &Stats() const;
   void KeyboardUnichar(char c, VTermModifier mod);
   void KeyboardKey(VTermKey key, VTermModifier mod);
   bool IsClosed() const;
+  // called on the pty reader thread when output arrives or the child exits,
+  // e.g. glfwPostEmptyEvent. call before Launch(cmd). a PtySessions pty
+  // wakes with PtySessions::SetWake
+  void SetWake(const std::function<void()> &wake);
+  // feed the pending pty output. true if the next Render changes the picture.
+  // an event driven host renders only then, on input or on resize
+  bool Poll();
+  // after a key, Poll waits up to echo_wait for the echo so that the key and
+  // its echo are presented by the same frame
+  void SetLowLatency(bool enable, std::chrono::microseconds echo_wait =
+                                      std::chrono::milliseconds(4));
+  // call right after the swap. the first key echoed by the presented frame is
+  // recorded as FrameStage::KeyToPresent
+  void Presented();
+  // bracketed if the child enabled it. streamed in the background, so a
+  // multi-MB paste does not block. see WriteStream for progress and cancel.
+  // nullptr before Launch
+  std::shared_ptr<common_pty::WriteStream> Paste(std::string_view text);
 };
 
 } // namespace termtexture
@@ -0,0 +1,229 @@
+#include "trace.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <plog/Log.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace tracing {
+
+std::atomic<bool> g_enabled = false;
+
+struct Event {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// written only by the owner thread. count is published with release
+struct EventChunk {
+  static const size_t EVENTS = 4096;
+  Event events[EVENTS];
+  std::atomic<size_t> count = 0;
+  std::atomic<EventChunk *> next = nullptr;
+};
+
+struct ThreadBuffer {
+  uint32_t tid = 0;
+  std::string name;
+  std::unique_ptr<EventChunk> head = std::make_unique<EventChunk>();
+  EventChunk *tail = head.get();
+  size_t chunks = 1;
+  // Start that the events belong to
+  std::atomic<uint64_t> generation = 0;
+  std::atomic<bool> alive = true;
+
+  ~ThreadBuffer() {
+    auto chunk = head->next.load();
+    while (chunk) {
+      auto next = chunk->next.load();
+      delete chunk;
+      chunk = next;
+    }
+  }
+
+  // chunks are kept for reuse
+  void Reset(uint64_t new_generation) {
+    for (auto chunk = head.get(); chunk; chunk = chunk->next.load()) {
+      chunk->count.store(0, std::memory_order_relaxed);
+    }
+    tail = head.get();
+    generation.store(new_generation, std::memory_order_release);
+  }
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  uint32_t next_tid = 1;
+  std::atomic<uint64_t> generation = 0;
+  size_t max_chunks = 1;
+  std::atomic<uint64_t> dropped = 0;
+  uint64_t start = 0;
+};
+
+static Registry &GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+// marks the buffer when the thread exits
+struct ThreadHolder {
+  std::shared_ptr<ThreadBuffer> buffer;
+  ~ThreadHolder() {
+    if (buffer) {
+      buffer->alive = false;
+    }
+  }
+};
+static thread_local ThreadHolder t_holder;
+
+static ThreadBuffer *GetThreadBuffer() {
+  if (!t_holder.buffer) {
+    auto &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    t_holder.buffer = std::make_shared<ThreadBuffer>();
+    t_holder.buffer->tid = registry.next_tid++;
+    t_holder.buffer->generation = registry.generation.load();
+    registry.buffers.push_back(t_holder.buffer);
+  }
+  return t_holder.buffer.get();
+}
+
+uint64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Start(size_t max_events) {
+  auto &registry = GetRegistry();
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    // buffers of exited threads
+    std::erase_if(registry.buffers, [](auto &buffer) { return !buffer->alive; });
+    registry.max_chunks =
+        std::max<size_t>(1, (max_events + EventChunk::EVENTS - 1) /
+                                EventChunk::EVENTS);
+    registry.dropped = 0;
+    registry.start = Now();
+    // each thread resets its own buffer at the next event
+    ++registry.generation;
+  }
+  g_enabled.store(true, std::memory_order_release);
+}
+
+void Stop() { g_enabled.store(false, std::memory_order_release); }
+
+void SetThreadName(const char *name) {
+  auto buffer = GetThreadBuffer();
+  std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+  buffer->name = name;
+}
+
+void Record(const char *name, uint64_t begin, uint64_t end) {
+  auto &registry = GetRegistry();
+  auto buffer = GetThreadBuffer();
+  auto generation = registry.generation.load(std::memory_order_acquire);
+  if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+    buffer->Reset(generation);
+  }
+
+  auto chunk = buffer->tail;
+  auto n = chunk->count.load(std::memory_order_relaxed);
+  if (n == EventChunk::EVENTS) {
+    auto next = chunk->next.load(std::memory_order_relaxed);
+    if (!next) {
+      if (buffer->chunks >= registry.max_chunks) {
+        registry.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      next = new EventChunk;
+      ++buffer->chunks;
+      chunk->next.store(next, std::memory_order_release);
+    }
+    buffer->tail = chunk = next;
+    n = 0;
+  }
+  chunk->events[n] = {name, begin, end};
+  chunk->count.store(n + 1, std::memory_order_release);
+}
+
+static void WriteString(FILE *fp, std::string_view s) {
+  fputc('"', fp);
+  for (auto c : s) {
+    if (c == '"' || c == '\\') {
+      fputc('\\', fp);
+      fputc(c, fp);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      fprintf(fp, "\\u%04x", c);
+    } else {
+      fputc(c, fp);
+    }
+  }
+  fputc('"', fp);
+}
+
+bool WriteChromeJson(std::string_view path) {
+  auto fp = fopen(std::string(path).c_str(), "wb");
+  if (!fp) {
+    PLOG_ERROR << "fopen: " << path;
+    return false;
+  }
+
+  auto &registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto generation = registry.generation.load();
+  fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  bool first = true;
+  auto separator = [&]() {
+    if (!first) {
+      fprintf(fp, ",\n");
+    }
+    first = false;
+  };
+  for (auto &buffer : registry.buffers) {
+    if (buffer->generation.load(std::memory_order_acquire) != generation) {
+      // no event since Start
+      continue;
+    }
+    if (!buffer->name.empty()) {
+      separator();
+      fprintf(fp,
+              "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,"
+              "\"args\":{\"name\":",
+              buffer->tid);
+      WriteString(fp, buffer->name);
+      fprintf(fp, "}}");
+    }
+    for (auto chunk = buffer->head.get(); chunk;
+         chunk = chunk->next.load(std::memory_order_acquire)) {
+      auto n = chunk->count.load(std::memory_order_acquire);
+      for (size_t i = 0; i < n; ++i) {
+        auto &e = chunk->events[i];
+        separator();
+        fprintf(fp, "{\"ph\":\"X\",\"name\":");
+        WriteString(fp, e.name);
+        // microseconds
+        fprintf(fp, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                buffer->tid,
+                static_cast<int64_t>(e.begin - registry.start) / 1000.0,
+                (e.end - e.begin) / 1000.0);
+      }
+      if (n < EventChunk::EVENTS) {
+        break;
+      }
+    }
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+
+  if (auto dropped = registry.dropped.load()) {
+    PLOG_WARNING << "trace: " << dropped << " events dropped";
+  }
+  return true;
+}
+
+} // namespace tracing
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+/// Scoped trace events for chrome://tracing and ui.perfetto.dev.
+///
+/// Each thread appends complete events to its own buffer without locks.
+/// WriteChromeJson collects all buffers. Call it after Stop, events that are
+/// being written while tracing are not included.
+///
+/// TRACE_SCOPE compiles to nothing without TERMTEXTURE_TRACE (meson option
+/// trace), and to a relaxed atomic load while tracing is stopped.
+namespace tracing {
+
+extern std::atomic<bool> g_enabled;
+inline bool IsEnabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+// discard previous events and start. max_events per thread, excess events
+// are dropped
+void Start(size_t max_events = 1 << 20);
+void Stop();
+// events recorded since Start
+bool WriteChromeJson(std::string_view path);
+// shown as the thread name. call before the first event on the thread
+void SetThreadName(const char *name);
+
+uint64_t Now();
+// name must be a static string
+void Record(const char *name, uint64_t begin, uint64_t end);
+
+class Scope {
+  const char *name_;
+  uint64_t begin_ = 0;
+
+public:
+  explicit Scope(const char *name) : name_(IsEnabled() ? name : nullptr) {
+    if (name_) {
+      begin_ = Now();
+    }
+  }
+  ~Scope() {
+    if (name_) {
+      Record(name_, begin_, Now());
+    }
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+};
+
+} // namespace tracing
+
+#ifdef TERMTEXTURE_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)                                                      \
+  ::tracing::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,128 @@
+#pragma once
+#include "unicode_tables.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+// Grapheme_Cluster_Break of UAX #29. Extended_Pictographic is a value too, as
+// those codepoints are all Other
+enum class GraphemeBreak : uint8_t {
+  Other,
+  CR,
+  LF,
+  Control,
+  Extend,
+  ZWJ,
+  RegionalIndicator,
+  Prepend,
+  SpacingMark,
+  L,
+  V,
+  T,
+  LV,
+  LVT,
+  ExtendedPictographic,
+};
+
+// break in the low 4 bits, width above. two array loads, no initialization.
+// 0 beyond U+10FFFF, e.g. CONTINUATION_CODEPOINT
+constexpr uint8_t UnicodeProperties(uint32_t codepoint) {
+  if (codepoint > 0x10FFFF) {
+    return 0;
+  }
+  constexpr uint32_t mask = (1u << unicode_tables::SHIFT) - 1;
+  uint32_t block = unicode_tables::STAGE1[codepoint >> unicode_tables::SHIFT];
+  return unicode_tables::STAGE2[block << unicode_tables::SHIFT |
+                                (codepoint & mask)];
+}
+
+// terminal columns. 0 for combining marks, format and control characters, 2
+// for East Asian wide and fullwidth
+constexpr int CodepointWidth(uint32_t codepoint) {
+  return UnicodeProperties(codepoint) >> 4;
+}
+
+constexpr GraphemeBreak GraphemeBreakOf(uint32_t codepoint) {
+  return static_cast<GraphemeBreak>(UnicodeProperties(codepoint) & 0x0F);
+}
+
+// UAX #29 GB3-GB999. no boundary between prev and next.
+// regional counts the regional indicators up to prev and pictographic_zwj is
+// prev being the ZWJ after ExtendedPictographic Extend*
+constexpr bool GraphemeJoins(GraphemeBreak prev, GraphemeBreak next,
+                             int regional, bool pictographic_zwj) {
+  using enum GraphemeBreak;
+  if (prev == CR && next == LF) {
+    return true;
+  }
+  if (prev == Control || prev == CR || prev == LF || next == Control ||
+      next == CR || next == LF) {
+    return false;
+  }
+  if (prev == L && (next == L || next == V || next == LV || next == LVT)) {
+    return true;
+  }
+  if ((prev == LV || prev == V) && (next == V || next == T)) {
+    return true;
+  }
+  if ((prev == LVT || prev == T) && next == T) {
+    return true;
+  }
+  if (next == Extend || next == ZWJ || next == SpacingMark ||
+      prev == Prepend) {
+    return true;
+  }
+  if (next == ExtendedPictographic && pictographic_zwj) {
+    return true;
+  }
+  if (prev == RegionalIndicator && next == RegionalIndicator) {
+    return regional % 2 == 1;
+  }
+  return false;
+}
+
+// the end of the extended grapheme cluster that starts at pos
+constexpr size_t NextGraphemeBoundary(std::u32string_view text, size_t pos) {
+  using enum GraphemeBreak;
+  if (pos >= text.size()) {
+    return text.size();
+  }
+  auto prev = GraphemeBreakOf(text[pos]);
+  int regional = prev == RegionalIndicator;
+  bool pictographic = prev == ExtendedPictographic;
+  bool pictographic_zwj = false;
+  size_t i = pos + 1;
+  for (; i < text.size(); ++i) {
+    auto next = GraphemeBreakOf(text[i]);
+    if (!GraphemeJoins(prev, next, regional, pictographic_zwj)) {
+      break;
+    }
+    regional = next == RegionalIndicator ? regional + 1 : 0;
+    pictographic_zwj = next == ZWJ && pictographic;
+    pictographic =
+        next == ExtendedPictographic || (pictographic && next == Extend);
+    prev = next;
+  }
+  return i;
+}
+
+// columns of a grapheme cluster. the first codepoint decides. a pictograph
+// with VS16 and a flag of two regional indicators are wide
+constexpr int ClusterWidth(std::u32string_view cluster) {
+  if (cluster.empty()) {
+    return 0;
+  }
+  auto width = CodepointWidth(cluster[0]);
+  if (width != 1) {
+    return width;
+  }
+  auto first = GraphemeBreakOf(cluster[0]);
+  if (first == GraphemeBreak::ExtendedPictographic &&
+      cluster.find(U'\uFE0F') != cluster.npos) {
+    return 2;
+  }
+  if (first == GraphemeBreak::RegionalIndicator && cluster.size() > 1) {
+    return 2;
+  }
+  return width;
+}
@@ -1,4 +1,5 @@
 #include "vterm_object.h"
+#include "trace.h"
 #include "vterm.h"
 #include <iostream>
 #include <plog/Log.h>
@@ -60,7 +61,14 @@ void VTermObject::keyboard_key(VTermKey key, VTermModifier mod) {
   vterm_keyboard_key(vterm_, key, mod);
 }
 
+void VTermObject::keyboard_start_paste() {
+  vterm_keyboard_start_paste(vterm_);
+}
+
+void VTermObject::keyboard_end_paste() { vterm_keyboard_end_paste(vterm_); }
+
 void VTermObject::input_write(const char *bytes, size_t len) {
+  TRACE_SCOPE("VTermObject::input_write");
   vterm_input_write(vterm_, bytes, len);
 }
 
@@ -99,6 +107,31 @@ VTermScreenCell *VTermObject::get_cell(VTermPos pos) const {
   return &cell_;
 }
 
+void VTermObject::get_codepoints(int row, std::vector<uint32_t> &out) const {
+  int rows, cols;
+  vterm_get_size(vterm_, &rows, &cols);
+  out.resize(cols);
+  VTermScreenCell cell;
+  for (int col = 0; col < cols; ++col) {
+    vterm_screen_get_cell(screen_, {.row = row, .col = col}, &cell);
+    out[col] = cell.chars[0];
+  }
+}
+
+void VTermObject::get_scrollback_line(size_t index, int cols,
+                                      std::vector<VTermScreenCell> &out) const {
+  out.resize(cols);
+  scrollback_.GetLine(index, cols, out.data());
+  for (auto &cell : out) {
+    if (VTERM_COLOR_IS_INDEXED(&cell.fg)) {
+      vterm_screen_convert_color_to_rgb(screen_, &cell.fg);
+    }
+    if (VTERM_COLOR_IS_INDEXED(&cell.bg)) {
+      vterm_screen_convert_color_to_rgb(screen_, &cell.bg);
+    }
+  }
+}
+
 std::optional<VTermPos> VTermObject::get_cursor() const {
   if (!cursor_visible_) {
     return {};
@@ -191,11 +224,10 @@ int VTermObject::resize(int rows, int cols) {
 }
 
 int VTermObject::sb_pushline(int cols, const VTermScreenCell *cells) {
-  PLOG_DEBUG << "sb_pushline";
+  scrollback_.Push(cols, cells);
   return 0;
 }
 
 int VTermObject::sb_popline(int cols, VTermScreenCell *cells) {
-  PLOG_DEBUG << "sb_popline";
-  return 0;
+  return scrollback_.Pop(cols, cells) ? 1 : 0;
 }
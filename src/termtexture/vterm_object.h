@@ -1,12 +1,14 @@
 #pragma once
+#include "scrollback.h"
 #include <functional>
 #include <memory>
 #include <stdexcept>
 #include <unordered_set>
 #include <vterm.h>
 #include <optional>
+#include <vector>
 
-template <> struct ::std::hash<VTermPos> {
+template <> struct std::hash<VTermPos> {
   std::size_t operator()(const VTermPos &p) const noexcept {
     return p.row << 16 | p.col;
   }
@@ -31,16 +33,28 @@ class VTermObject {
   PosSet damaged_;
   PosSet tmp_;
 
+  Scrollback scrollback_;
+
 public:
   VTermObject(int _rows, int _cols, VTermOutputCallback out, void *user);
   ~VTermObject();
   void input_write(const char *bytes, size_t len);
   void keyboard_unichar(char c, VTermModifier mod);
   void keyboard_key(VTermKey key, VTermModifier mod);
+  // outputs the bracket if the child enabled bracketed paste
+  void keyboard_start_paste();
+  void keyboard_end_paste();
   const PosSet &new_frame(bool *ringing, bool check_damaged = true);
   VTermScreenCell *get_cell(VTermPos pos) const;
+  // chars[0] of each cell in the row
+  void get_codepoints(int row, std::vector<uint32_t> &out) const;
+  // scrollback line with rgb colors
+  void get_scrollback_line(size_t index, int cols,
+                           std::vector<VTermScreenCell> &out) const;
   std::optional<VTermPos> get_cursor() const;
   void resize_rows_cols(int rows, int cols);
+  Scrollback &scrollback() { return scrollback_; }
+  const Scrollback &scrollback() const { return scrollback_; }
 
 private:
   static int damage(VTermRect rect, void *user);
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <scrollback.h>
+#include <search.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// scrollback_test [filter]
+// prints the failed checks. exit code 1 if any
+
+static std::string_view g_filter;
+static int g_failures = 0;
+
+static void Check(bool value, const char *expr, int line) {
+  if (!value) {
+    printf("%s:%d: %s\n", __FILE__, line, expr);
+    ++g_failures;
+  }
+}
+#define CHECK(expr) Check((expr), #expr, __LINE__)
+
+static void Test(std::string_view name, const std::function<void()> &func) {
+  if (name.find(g_filter) == std::string_view::npos) {
+    return;
+  }
+  auto failures = g_failures;
+  func();
+  printf("%s: %s\n", failures == g_failures ? "ok" : "FAILED",
+         std::string(name).c_str());
+}
+
+static std::vector<VTermScreenCell> Line(std::string_view text, int cols) {
+  std::vector<VTermScreenCell> cells(cols);
+  for (int i = 0; i < cols; ++i) {
+    cells[i].width = 1;
+    cells[i].chars[0] = i < static_cast<int>(text.size()) ? text[i] : 0;
+  }
+  return cells;
+}
+
+static size_t Count(const Scrollback &scrollback, std::string_view pattern,
+                    bool ignore_case) {
+  auto matcher = LineMatcher::Create(pattern, {.ignore_case = ignore_case});
+  size_t count = 0;
+  scrollback.Search(*matcher, [&count](size_t, int, int) {
+    ++count;
+    return true;
+  });
+  return count;
+}
+
+// an upper case pattern in chunks compressed in background
+static void SearchColdChunks() {
+  const int cols = 40;
+  const size_t chunks = 4;
+  std::atomic<int> compressed = 0;
+  Scrollback scrollback(0);
+  scrollback.SetOnCompressed([&compressed]() { ++compressed; });
+  scrollback.SetCompression(true, 1);
+  for (size_t i = 0; i < ScrollbackChunk::LINES * chunks; ++i) {
+    auto text = i % 100 == 0 ? "ERROR in Error line " + std::to_string(i)
+                             : "line " + std::to_string(i);
+    scrollback.Push(cols, Line(text, cols).data());
+  }
+  // all but the open chunk
+  const int cold = static_cast<int>(chunks) - 1;
+  for (int i = 0; i < 500 && compressed < cold; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  scrollback.Update();
+  CHECK(compressed == cold);
+
+  auto lines = ScrollbackChunk::LINES * chunks / 100 + 1;
+  CHECK(Count(scrollback, "ERROR", false) == lines);
+  CHECK(Count(scrollback, "Error", false) == lines);
+  CHECK(Count(scrollback, "error", false) == 0);
+  CHECK(Count(scrollback, "error", true) == lines * 2);
+  CHECK(Count(scrollback, "WARNING", false) == 0);
+}
+
+// a needle with a combining mark matches on its base, whether a line is
+// stored with 1 byte or 4 byte codepoints
+static void SearchNarrowAndWideLines() {
+  const int cols = 40;
+  Scrollback scrollback(0);
+  scrollback.SetCompression(false);
+  scrollback.Push(cols, Line("cafe au lait", cols).data());
+  auto wide = Line("cafe ?", cols);
+  // U+1F600. the line is stored with 4 byte codepoints
+  wide[5].chars[0] = 0x1F600;
+  scrollback.Push(cols, wide.data());
+
+  auto matcher = LineMatcher::Create("cafe\xcc\x81", {});
+  std::vector<size_t> lines;
+  bool at_base = true;
+  scrollback.Search(*matcher, [&](size_t index, int col, int length) {
+    lines.push_back(index);
+    at_base = at_base && col == 0 && length == 4;
+    return true;
+  });
+  CHECK(lines == std::vector<size_t>({0, 1}));
+  CHECK(at_base);
+}
+
+// a byte cap evicts the oldest chunks only. the count of bytes does not
+// drift as chunks come and go
+static void ByteLimit() {
+  const int cols = 40;
+  // about four chunks of these lines
+  const size_t max_bytes = 100000;
+  const size_t chunks = 128;
+  Scrollback scrollback(0, max_bytes);
+  scrollback.SetCompression(false);
+  bool under_limit = true;
+  size_t min_size = SIZE_MAX;
+  size_t max_size = 0;
+  for (size_t i = 0; i < ScrollbackChunk::LINES * chunks; ++i) {
+    auto text = "line " + std::to_string(i);
+    scrollback.Push(cols, Line(text, cols).data());
+    under_limit = under_limit && scrollback.Bytes() <= max_bytes;
+    if (i >= ScrollbackChunk::LINES * 8) {
+      min_size = std::min(min_size, scrollback.Size());
+      max_size = std::max(max_size, scrollback.Size());
+    }
+  }
+  CHECK(under_limit);
+  CHECK(min_size > ScrollbackChunk::LINES * 2);
+  CHECK(max_size <= ScrollbackChunk::LINES * 4);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    g_filter = argv[1];
+  }
+  Test("scrollback/search_cold_chunks", &SearchColdChunks);
+  Test("scrollback/search_narrow_and_wide_lines", &SearchNarrowAndWideLines);
+  Test("scrollback/byte_limit", &ByteLimit);
+  return g_failures ? 1 : 0;
+}